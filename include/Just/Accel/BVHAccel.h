@@ -2,19 +2,353 @@
 
 #include "Just/Common.h"
 #include "Just/Core/Accel.h"
+#include "Just/Geometry/Triangle.h"
+
+//线性BVH节点，按深度优先顺序排列，第一个子节点紧跟父节点
+struct alignas(32) LinearBVHNode
+{
+    Bounds3f bounds;
+    union
+    {
+        uint32_t primitivesOffset; //叶子节点：图元在faceIndices中的起始位置
+        uint32_t secondChildOffset; //内部节点：第二个子节点的位置
+    };
+    uint16_t primitiveCount; //叶子节点图元数量
+    uint8_t axis; //内部节点划分轴
+    uint8_t isLeaf;
+    LinearBVHNode() : primitivesOffset(0), primitiveCount(0), axis(0), isLeaf(0) {}
+};
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should be 32 bytes");
+
+//BVH构建方式
+enum class BVHBuildMethod
+{
+    Sorted = 0, //逐节点排序后等分分桶
+    BinnedSAH = 1, //质心分箱SAH，原地划分
+};
+
+//分箱构建时的图元信息
+struct BVHPrimitiveInfo
+{
+    Bounds3f bounds;
+    Point3f centroid;
+};
+
+//SAH分箱
+struct BVHBin
+{
+    Bounds3f bounds;
+    uint32_t count = 0;
+};
 
 struct BVHAccel : public Accel
 {
 private:
     const int kNumBuckets = 10;
+protected:
+    //分箱数量
+    static constexpr int kNumBins = 16;
+    //SAH节点遍历成本
+    static constexpr float kTraversalCost = 0.125f;
+    //遍历栈大小，需大于最大深度
+    static constexpr int kMaxStackSize = 64;
+    //图元数量超过该值的节点并行构建子树
+    static constexpr uint32_t kParallelThreshold = 4096;
 public:
-    explicit BVHAccel(int nums = 16, int depth = 32) : Accel(nums, depth) {}
+    explicit BVHAccel(int nums = 16, int depth = 32, bool isLinear = true,
+                      BVHBuildMethod method = BVHBuildMethod::BinnedSAH)
+            : Accel(nums, depth), isLinear(isLinear), buildMethod(method) {}
     ~BVHAccel() override = default;
+    virtual void Build() override;
+    virtual void Refit(size_t meshIndex) override;
     virtual void Divide(size_t nodeIndex, std::vector<AccelNode> &children) override;
     virtual void Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t> &queue) const override;
-    virtual void StaticCulling() override;
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const override;
+    virtual void OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                                  const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const override;
+    virtual void Flatten() override;
+    virtual bool Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const override;
+    virtual uint32_t IntersectPacket8(const Ray *rays, HitRecord *records, size_t *hitFaces, int count) const override;
+    virtual bool Occluded(const Ray &ray, float tMax) const override;
+    virtual uint64_t ContentHash() const override;
+    virtual bool SaveCache(const std::string &path) const override;
+    virtual bool LoadCache(const std::string &path) override;
+    virtual AccelStats CollectStats() const override;
+private:
+    uint32_t FlattenNode(size_t nodeIndex, std::vector<std::pair<size_t, size_t>> &orderedFaces);
+    //展开图元数量超过maxLeafSize的叶子，按质心中位数递归拆分为子树
+    uint32_t FlattenFaces(std::pair<size_t, size_t> *faces, size_t count,
+                          std::vector<std::pair<size_t, size_t>> &orderedFaces);
+protected:
+    uint32_t BuildBinned(uint32_t begin, uint32_t end, int depth, std::vector<LinearBVHNode> &nodes);
+    static uint32_t AppendSubtree(std::vector<LinearBVHNode> &nodes, const std::vector<LinearBVHNode> &subtree);
+    void CountLinearTree();
+    void PrecomputeTriangles();
+    void FinishLinearBuild();
+    //线性树深度优先遍历，叶子节点交给leafFunc处理，返回访问的节点数量
+    template<typename LeafFunc>
+    uint32_t TraverseLinear(const Ray &ray, LeafFunc &&leafFunc) const;
+    //叶子节点内图元求交
+    bool IntersectLeaf(uint32_t primitivesOffset, uint32_t primitiveCount, const Ray &ray, HitRecord &record,
+                       size_t &hitMesh, size_t &hitFace, bool isShadow) const;
+    //叶子节点内图元遮挡测试
+    bool OccludedLeaf(uint32_t primitivesOffset, uint32_t primitiveCount, const Ray &ray) const;
+public:
+    //树的SAH成本，以根节点表面积归一化
+    float SAHCost() const;
+    //最近交点查询访问的节点数量，用于比较不同构建方式
+    uint32_t TraversalSteps(const Ray &ray) const;
+    //是否使用线性BVH布局
+    bool isLinear;
+    //构建方式，分箱构建直接生成线性BVH
+    BVHBuildMethod buildMethod;
+    //线性BVH树
+    std::vector<LinearBVHNode> linearTree;
+    //是否预计算三角形数据
+    bool isPrecomputed = true;
+    //按叶子顺序排列的预计算三角形
+    std::vector<PrecomputedTriangle> triangles;
+    //叶子的最大图元数量，不能超过节点图元数量字段的范围
+    uint32_t maxLeafSize = std::numeric_limits<uint16_t>::max();
+    //构建完成时的SAH成本
+    float buildCost = 0.0f;
+    //更新后SAH成本超过构建成本的该倍数时重新构建，不大于0时不重建
+    float rebuildThreshold = 0.0f;
+protected:
+    //构建时的临时数据
+    std::vector<BVHPrimitiveInfo> primitiveInfos;
+    std::vector<uint32_t> primitiveOrder;
 };
 
+void BVHAccel::Build()
+{
+    if (!isLinear || buildMethod == BVHBuildMethod::Sorted)
+    {
+        Accel::Build();
+        return;
+    }
+    std::cout << "[info]: building accel (binned SAH)......" << "\n";
+    std::cout << "[mesh count]:" << meshes.size() << "\n";
+    std::cout << "[triangle count]:" << faceIndices.size() << "\n";
+    linearTree.clear();
+    if (faceIndices.empty())
+    {
+        return;
+    }
+    //预计算图元包围盒与质心
+    auto count = static_cast<uint32_t>(faceIndices.size());
+    primitiveInfos.resize(count);
+    primitiveOrder.resize(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        auto [meshIndex, faceIndex] = faceIndices[i];
+        primitiveInfos[i].bounds = meshes[meshIndex]->GetFaceBounds(faceIndex);
+        primitiveInfos[i].centroid = primitiveInfos[i].bounds.Centroid();
+        primitiveOrder[i] = static_cast<uint32_t>(i);
+    }
+    //递归构建，节点按深度优先顺序写入，大节点的两棵子树作为任务并行构建
+    linearTree.reserve(2 * count / std::max(minNumFaces, 1) + 1);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+    BuildBinned(0, count, 0, linearTree);
+    //按叶子顺序重排图元
+    std::vector<std::pair<size_t, size_t>> orderedFaces(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        orderedFaces[i] = faceIndices[primitiveOrder[i]];
+    }
+    faceIndices.swap(orderedFaces);
+    primitiveInfos.clear();
+    primitiveInfos.shrink_to_fit();
+    primitiveOrder.clear();
+    primitiveOrder.shrink_to_fit();
+    FinishLinearBuild();
+    //统计数据
+    CountLinearTree();
+    std::cout << "[tree depth]: " << currDepth << std::endl;
+    std::cout << "[node count]: " << nodeCount << std::endl;
+    std::cout << "[leaf count]: " << leafCount << std::endl;
+}
+uint32_t BVHAccel::BuildBinned(uint32_t begin, uint32_t end, int depth, std::vector<LinearBVHNode> &nodes)
+{
+    auto offset = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    //计算节点包围盒与质心包围盒
+    Bounds3f nodeBounds, centroidBounds;
+    for (uint32_t i = begin; i < end; ++i)
+    {
+        const auto &info = primitiveInfos[primitiveOrder[i]];
+        nodeBounds.Expand(info.bounds);
+        centroidBounds.Expand(info.centroid);
+    }
+    nodes[offset].bounds = nodeBounds;
+    uint32_t count = end - begin;
+    //叶子图元数量受节点字段宽度限制
+    bool canBeLeaf = count <= maxLeafSize;
+    if (canBeLeaf && (count <= static_cast<uint32_t>(minNumFaces) || depth >= maxDepth))
+    {
+        nodes[offset].isLeaf = 1;
+        nodes[offset].primitivesOffset = begin;
+        nodes[offset].primitiveCount = static_cast<uint16_t>(count);
+        return offset;
+    }
+
+    //在三个维度上分箱，选取SAH成本最小的划分
+    Vector3f extent = centroidBounds.Diagonal();
+    float invSA = 1.0f / nodeBounds.SurfaceArea();
+    float minCost = std::numeric_limits<float>::infinity();
+    int bestAxis = -1;
+    int bestSplit = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent[axis] <= 0.0f)
+        {
+            continue;
+        }
+        BVHBin bins[kNumBins];
+        float scale = static_cast<float>(kNumBins) / extent[axis];
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            const auto &info = primitiveInfos[primitiveOrder[i]];
+            int b = std::min(kNumBins - 1, static_cast<int>((info.centroid[axis] - centroidBounds.pMin[axis]) * scale));
+            bins[b].count++;
+            bins[b].bounds.Expand(info.bounds);
+        }
+        //从右向左累计右侧包围盒
+        float rightArea[kNumBins];
+        uint32_t rightCount[kNumBins];
+        Bounds3f rightBounds;
+        uint32_t rightSum = 0;
+        for (int b = kNumBins - 1; b > 0; --b)
+        {
+            rightBounds.Expand(bins[b].bounds);
+            rightSum += bins[b].count;
+            rightArea[b] = rightSum > 0 ? rightBounds.SurfaceArea() : 0.0f;
+            rightCount[b] = rightSum;
+        }
+        //从左向右扫描计算成本
+        Bounds3f leftBounds;
+        uint32_t leftSum = 0;
+        for (int b = 1; b < kNumBins; ++b)
+        {
+            leftBounds.Expand(bins[b - 1].bounds);
+            leftSum += bins[b - 1].count;
+            if (leftSum == 0 || rightCount[b] == 0)
+            {
+                continue;
+            }
+            float cost = kTraversalCost +
+                         (static_cast<float>(leftSum) * leftBounds.SurfaceArea() +
+                          static_cast<float>(rightCount[b]) * rightArea[b]) * invSA;
+            if (cost < minCost)
+            {
+                minCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+            }
+        }
+    }
+
+    //原地划分图元索引
+    uint32_t mid = begin;
+    if (bestAxis >= 0)
+    {
+        float pMin = centroidBounds.pMin[bestAxis];
+        float scale = static_cast<float>(kNumBins) / extent[bestAxis];
+        auto it = std::partition(
+                primitiveOrder.begin() + begin,
+                primitiveOrder.begin() + end,
+                [&](uint32_t p) {
+                    float c = primitiveInfos[p].centroid[bestAxis];
+                    return std::min(kNumBins - 1, static_cast<int>((c - pMin) * scale)) < bestSplit;
+                }
+        );
+        mid = static_cast<uint32_t>(it - primitiveOrder.begin());
+    }
+    //无有效划分时按最长维度中位数划分
+    if (mid == begin || mid == end)
+    {
+        int axis = static_cast<int>(centroidBounds.MajorAxis());
+        bestAxis = axis;
+        mid = begin + count / 2;
+        std::nth_element(
+                primitiveOrder.begin() + begin,
+                primitiveOrder.begin() + mid,
+                primitiveOrder.begin() + end,
+                [this, axis](uint32_t l, uint32_t r) {
+                    return primitiveInfos[l].centroid[axis] < primitiveInfos[r].centroid[axis];
+                }
+        );
+    }
+
+    //第一个子节点紧跟父节点
+    nodes[offset].axis = static_cast<uint8_t>(bestAxis);
+    if (count < kParallelThreshold)
+    {
+        BuildBinned(begin, mid, depth + 1, nodes);
+        nodes[offset].secondChildOffset = BuildBinned(mid, end, depth + 1, nodes);
+        return offset;
+    }
+    //子树写入各自的数组，完成后按固定顺序拼接，保证结果与线程调度无关
+    std::vector<LinearBVHNode> leftNodes, rightNodes;
+#ifdef ENABLE_OPENMP
+#pragma omp task shared(leftNodes) firstprivate(begin, mid, depth)
+#endif
+    BuildBinned(begin, mid, depth + 1, leftNodes);
+#ifdef ENABLE_OPENMP
+#pragma omp task shared(rightNodes) firstprivate(mid, end, depth)
+#endif
+    BuildBinned(mid, end, depth + 1, rightNodes);
+#ifdef ENABLE_OPENMP
+#pragma omp taskwait
+#endif
+    AppendSubtree(nodes, leftNodes);
+    nodes[offset].secondChildOffset = AppendSubtree(nodes, rightNodes);
+    return offset;
+}
+uint32_t BVHAccel::AppendSubtree(std::vector<LinearBVHNode> &nodes, const std::vector<LinearBVHNode> &subtree)
+{
+    //子树内部的子节点偏移加上拼接位置
+    auto base = static_cast<uint32_t>(nodes.size());
+    nodes.insert(nodes.end(), subtree.begin(), subtree.end());
+    for (size_t i = base; i < nodes.size(); ++i)
+    {
+        if (!nodes[i].isLeaf)
+        {
+            nodes[i].secondChildOffset += base;
+        }
+    }
+    return base;
+}
+void BVHAccel::CountLinearTree()
+{
+    //父节点总在子节点之前，正序遍历即可得到每个节点的深度
+    std::vector<int> depths(linearTree.size(), 0);
+    nodeCount = static_cast<int>(linearTree.size());
+    leafCount = 0;
+    currDepth = 0;
+    for (size_t i = 0; i < linearTree.size(); ++i)
+    {
+        currDepth = std::max(currDepth, depths[i] + 1);
+        if (linearTree[i].isLeaf)
+        {
+            ++leafCount;
+        }
+        else
+        {
+            depths[i + 1] = depths[i] + 1;
+            depths[linearTree[i].secondChildOffset] = depths[i] + 1;
+        }
+    }
+}
 void BVHAccel::Divide(size_t nodeIndex, std::vector<AccelNode> &children)
 {
     auto& node = tree[nodeIndex];
@@ -78,7 +412,609 @@ void BVHAccel::Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t> &qu
     queue.push(tree[nodeIndex].child);
     queue.push(tree[nodeIndex].child + 1);
 }
-void BVHAccel::StaticCulling()
+void BVHAccel::StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
 {
+    if (linearTree.empty())
+    {
+        CullTreeLeaves(frustum, visibleFaces);
+        return;
+    }
+    //栈中同时保存平面掩码，父节点完全在内侧的平面不再测试
+    std::pair<uint32_t, uint32_t> stack[kMaxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = {0, Frustum::kAllPlanes};
+    while (stackSize > 0)
+    {
+        auto [current, planeMask] = stack[--stackSize];
+        const auto &node = linearTree[current];
+        if (planeMask != 0 && !frustum.Intersect(node.bounds, planeMask))
+        {
+            continue;
+        }
+        if (node.isLeaf)
+        {
+            auto begin = faceIndices.begin() + node.primitivesOffset;
+            visibleFaces.insert(visibleFaces.end(), begin, begin + node.primitiveCount);
+        }
+        else
+        {
+            stack[stackSize++] = {node.secondChildOffset, planeMask};
+            stack[stackSize++] = {current + 1, planeMask};
+        }
+    }
 }
-
+void BVHAccel::OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                                const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const
+{
+    if (linearTree.empty())
+    {
+        Accel::OcclusionCulling(frustum, isOccluded, visitLeaf);
+        return;
+    }
+    std::pair<uint32_t, uint32_t> stack[kMaxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = {0, Frustum::kAllPlanes};
+    while (stackSize > 0)
+    {
+        auto [current, planeMask] = stack[--stackSize];
+        const auto &node = linearTree[current];
+        if (planeMask != 0 && !frustum.Intersect(node.bounds, planeMask))
+        {
+            continue;
+        }
+        if (isOccluded(node.bounds))
+        {
+            continue;
+        }
+        if (node.isLeaf)
+        {
+            visitLeaf(faceIndices.data() + node.primitivesOffset, node.primitiveCount);
+            continue;
+        }
+        //近处子节点后入栈，先访问
+        uint32_t nearChild = current + 1, farChild = node.secondChildOffset;
+        if (frustum.Depth(linearTree[farChild].bounds.Centroid()) <
+            frustum.Depth(linearTree[nearChild].bounds.Centroid()))
+        {
+            std::swap(nearChild, farChild);
+        }
+        stack[stackSize++] = {farChild, planeMask};
+        stack[stackSize++] = {nearChild, planeMask};
+    }
+}
+void BVHAccel::Flatten()
+{
+    linearTree.clear();
+    if (!isLinear || tree.empty())
+    {
+        return;
+    }
+    //深度优先展开，叶子节点图元按遍历顺序重排
+    std::vector<std::pair<size_t, size_t>> orderedFaces;
+    orderedFaces.reserve(faceIndices.size());
+    linearTree.reserve(tree.size());
+    FlattenNode(0, orderedFaces);
+    faceIndices.swap(orderedFaces);
+    //释放原始树
+    tree.clear();
+    tree.shrink_to_fit();
+    std::cout << "[linear node size]: " << sizeof(LinearBVHNode) << " bytes" << std::endl;
+    FinishLinearBuild();
+}
+void BVHAccel::Refit(size_t meshIndex)
+{
+    if (linearTree.empty())
+    {
+        Accel::Refit(meshIndex);
+        return;
+    }
+    const auto &mesh = meshes[meshIndex];
+    mesh->UpdateBounds();
+    //更新该网格的预计算三角形
+    if (!triangles.empty())
+    {
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int i = 0; i < static_cast<int>(triangles.size()); ++i)
+        {
+            auto &triangle = triangles[i];
+            if (triangle.meshIndex != meshIndex)
+            {
+                continue;
+            }
+            auto [idx0, idx1, idx2] = mesh->GetTriangleIndices(triangle.faceIndex);
+            triangle = PrecomputedTriangle(mesh->positions[idx0], mesh->positions[idx1], mesh->positions[idx2],
+                                           triangle.meshIndex, triangle.faceIndex);
+        }
+    }
+    //子节点总在父节点之后，逆序遍历即可自底向上更新包围盒
+    for (size_t i = linearTree.size(); i-- > 0;)
+    {
+        auto &node = linearTree[i];
+        if (node.isLeaf)
+        {
+            Bounds3f leafBounds;
+            for (uint32_t j = 0; j < node.primitiveCount; ++j)
+            {
+                auto [m, f] = faceIndices[node.primitivesOffset + j];
+                leafBounds.Expand(meshes[m]->GetFaceBounds(f));
+            }
+            node.bounds = leafBounds;
+        }
+        else
+        {
+            node.bounds = Union(linearTree[i + 1].bounds, linearTree[node.secondChildOffset].bounds);
+        }
+    }
+    bounds = linearTree[0].bounds;
+    //拓扑不变，树的质量下降过多时重新构建
+    float cost = SAHCost();
+    if (rebuildThreshold > 0.0f && cost > buildCost * rebuildThreshold)
+    {
+        std::cout << "[info]: refit SAH cost " << cost << " exceeds " << rebuildThreshold
+                  << "x build cost " << buildCost << ", rebuilding......" << "\n";
+        Build();
+    }
+}
+float BVHAccel::SAHCost() const
+{
+    if (linearTree.empty())
+    {
+        return 0.0f;
+    }
+    float rootSA = linearTree[0].bounds.SurfaceArea();
+    if (rootSA <= 0.0f)
+    {
+        return 0.0f;
+    }
+    float cost = 0.0f;
+    for (const auto &node: linearTree)
+    {
+        float weight = node.isLeaf ? static_cast<float>(node.primitiveCount) : kTraversalCost;
+        cost += weight * node.bounds.SurfaceArea();
+    }
+    return cost / rootSA;
+}
+AccelStats BVHAccel::CollectStats() const
+{
+    if (linearTree.empty())
+    {
+        return Accel::CollectStats();
+    }
+    AccelStats stats;
+    stats.type = ReadableTypeName(typeid(*this));
+    stats.nodeCount = nodeCount;
+    stats.leafCount = leafCount;
+    stats.maxDepth = currDepth;
+    stats.sahCost = SAHCost();
+    std::vector<int> depths(linearTree.size(), 0);
+    for (size_t i = 0; i < linearTree.size(); ++i)
+    {
+        const auto &node = linearTree[i];
+        if (node.isLeaf)
+        {
+            stats.AddLeaf(node.primitiveCount, depths[i]);
+        }
+        else
+        {
+            depths[i + 1] = depths[i] + 1;
+            depths[node.secondChildOffset] = depths[i] + 1;
+        }
+    }
+    return stats;
+}
+uint64_t BVHAccel::ContentHash() const
+{
+    uint64_t hash = Accel::ContentHash();
+    hash = HashValue(kNumBuckets, hash);
+    hash = HashValue(kNumBins, hash);
+    hash = HashValue(isLinear, hash);
+    hash = HashValue(buildMethod, hash);
+    return hash;
+}
+bool BVHAccel::SaveCache(const std::string &path) const
+{
+    //只缓存线性BVH，预计算三角形在读取时重新生成
+    if (linearTree.empty())
+    {
+        return false;
+    }
+    std::vector<uint32_t> packedFaces(2 * faceIndices.size());
+    for (size_t i = 0; i < faceIndices.size(); ++i)
+    {
+        packedFaces[2 * i + 0] = static_cast<uint32_t>(faceIndices[i].first);
+        packedFaces[2 * i + 1] = static_cast<uint32_t>(faceIndices[i].second);
+    }
+    CacheWriter writer(path, ContentHash());
+    writer.Write(bounds);
+    writer.Write(buildCost);
+    writer.WriteVector(linearTree);
+    writer.WriteVector(packedFaces);
+    return writer.IsValid();
+}
+bool BVHAccel::LoadCache(const std::string &path)
+{
+    CacheReader reader(path, ContentHash());
+    std::vector<uint32_t> packedFaces;
+    Bounds3f cachedBounds;
+    float cachedCost = 0.0f;
+    std::vector<LinearBVHNode> cachedTree;
+    if (!reader.Read(cachedBounds) || !reader.Read(cachedCost) ||
+        !reader.ReadVector(cachedTree) || !reader.ReadVector(packedFaces) || cachedTree.empty())
+    {
+        return false;
+    }
+    if (packedFaces.size() % 2 != 0)
+    {
+        return false;
+    }
+    //图元顺序按叶子顺序恢复，空间划分时可能包含重复图元
+    std::vector<std::pair<size_t, size_t>> cachedFaces(packedFaces.size() / 2);
+    for (size_t i = 0; i < cachedFaces.size(); ++i)
+    {
+        size_t meshIndex = packedFaces[2 * i + 0], faceIndex = packedFaces[2 * i + 1];
+        if (meshIndex >= meshes.size() || faceIndex >= meshes[meshIndex]->GetTriangleCount())
+        {
+            return false;
+        }
+        cachedFaces[i] = {meshIndex, faceIndex};
+    }
+    //节点引用必须在数组范围内，第二个子节点总在当前节点之后，遍历不会越界或成环，深度不超过遍历栈
+    std::vector<int> depths(cachedTree.size(), 0);
+    for (size_t i = 0; i < cachedTree.size(); ++i)
+    {
+        const auto &node = cachedTree[i];
+        if (depths[i] >= kMaxStackSize)
+        {
+            return false;
+        }
+        if (node.isLeaf)
+        {
+            if (static_cast<size_t>(node.primitivesOffset) + node.primitiveCount > cachedFaces.size())
+            {
+                return false;
+            }
+        }
+        else if (node.secondChildOffset <= i + 1 || node.secondChildOffset >= cachedTree.size())
+        {
+            return false;
+        }
+        else
+        {
+            depths[i + 1] = depths[i] + 1;
+            depths[node.secondChildOffset] = depths[i] + 1;
+        }
+    }
+    faceIndices.swap(cachedFaces);
+    bounds = cachedBounds;
+    buildCost = cachedCost;
+    linearTree.swap(cachedTree);
+    tree.clear();
+    PrecomputeTriangles();
+    CountLinearTree();
+    return true;
+}
+uint32_t BVHAccel::TraversalSteps(const Ray &ray) const
+{
+    if (linearTree.empty())
+    {
+        return 0;
+    }
+    //与Intersect相同的遍历，只统计访问的节点，求交会缩短tMax，使用射线副本
+    Ray closestRay = ray;
+    HitRecord record;
+    size_t hitMesh = 0, hitFace = 0;
+    return TraverseLinear(closestRay, [&](const LinearBVHNode &node) {
+        IntersectLeaf(node.primitivesOffset, node.primitiveCount, closestRay, record, hitMesh, hitFace, false);
+        return false;
+    });
+}
+void BVHAccel::FinishLinearBuild()
+{
+    PrecomputeTriangles();
+    buildCost = SAHCost();
+}
+void BVHAccel::PrecomputeTriangles()
+{
+    triangles.clear();
+    triangles.shrink_to_fit();
+    if (!isPrecomputed || linearTree.empty())
+    {
+        return;
+    }
+    //按叶子顺序连续存放，叶子内求交只访问该数组
+    triangles.resize(faceIndices.size());
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(faceIndices.size()); ++i)
+    {
+        auto [meshIndex, faceIndex] = faceIndices[i];
+        const auto &mesh = meshes[meshIndex];
+        auto [idx0, idx1, idx2] = mesh->GetTriangleIndices(faceIndex);
+        triangles[i] = PrecomputedTriangle(mesh->positions[idx0], mesh->positions[idx1], mesh->positions[idx2],
+                                           static_cast<uint32_t>(meshIndex), static_cast<uint32_t>(faceIndex));
+    }
+}
+uint32_t BVHAccel::FlattenNode(size_t nodeIndex, std::vector<std::pair<size_t, size_t>> &orderedFaces)
+{
+    const auto &node = tree[nodeIndex];
+    if (node.child == 0 && node.faceIndices.size() > maxLeafSize)
+    {
+        std::vector<std::pair<size_t, size_t>> faces(node.faceIndices.begin(), node.faceIndices.end());
+        return FlattenFaces(faces.data(), faces.size(), orderedFaces);
+    }
+    auto offset = static_cast<uint32_t>(linearTree.size());
+    linearTree.emplace_back();
+    linearTree[offset].bounds = node.bounds;
+    if (node.child == 0)
+    {
+        //叶子节点记录图元范围
+        linearTree[offset].isLeaf = 1;
+        linearTree[offset].primitivesOffset = static_cast<uint32_t>(orderedFaces.size());
+        linearTree[offset].primitiveCount = static_cast<uint16_t>(node.faceIndices.size());
+        orderedFaces.insert(orderedFaces.end(), node.faceIndices.begin(), node.faceIndices.end());
+    }
+    else
+    {
+        //内部节点记录划分轴与第二个子节点位置
+        linearTree[offset].axis = static_cast<uint8_t>(node.bounds.MajorAxis());
+        FlattenNode(node.child, orderedFaces);
+        linearTree[offset].secondChildOffset = FlattenNode(node.child + 1, orderedFaces);
+    }
+    return offset;
+}
+uint32_t BVHAccel::FlattenFaces(std::pair<size_t, size_t> *faces, size_t count,
+                                std::vector<std::pair<size_t, size_t>> &orderedFaces)
+{
+    auto offset = static_cast<uint32_t>(linearTree.size());
+    linearTree.emplace_back();
+    Bounds3f nodeBounds, centroidBounds;
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto faceBounds = meshes[faces[i].first]->GetFaceBounds(faces[i].second);
+        nodeBounds.Expand(faceBounds);
+        centroidBounds.Expand(faceBounds.Centroid());
+    }
+    linearTree[offset].bounds = nodeBounds;
+    if (count <= maxLeafSize)
+    {
+        linearTree[offset].isLeaf = 1;
+        linearTree[offset].primitivesOffset = static_cast<uint32_t>(orderedFaces.size());
+        linearTree[offset].primitiveCount = static_cast<uint16_t>(count);
+        orderedFaces.insert(orderedFaces.end(), faces, faces + count);
+        return offset;
+    }
+    int axis = static_cast<int>(centroidBounds.MajorAxis());
+    size_t mid = count / 2;
+    std::nth_element(faces, faces + mid, faces + count,
+                     [this, axis](const std::pair<size_t, size_t> &l, const std::pair<size_t, size_t> &r) {
+                         return meshes[l.first]->GetFaceBounds(l.second).Centroid()[axis] <
+                                meshes[r.first]->GetFaceBounds(r.second).Centroid()[axis];
+                     });
+    linearTree[offset].axis = static_cast<uint8_t>(axis);
+    FlattenFaces(faces, mid, orderedFaces);
+    linearTree[offset].secondChildOffset = FlattenFaces(faces + mid, count - mid, orderedFaces);
+    return offset;
+}
+template<typename LeafFunc>
+uint32_t BVHAccel::TraverseLinear(const Ray &ray, LeafFunc &&leafFunc) const
+{
+    //预计算方向倒数与符号
+    Vector3f invDir = 1.0f / ray.direction;
+    const bool dirIsNeg[3] = {invDir.x < 0, invDir.y < 0, invDir.z < 0};
+    //栈式深度优先遍历
+    uint32_t stack[kMaxStackSize];
+    int stackSize = 0;
+    uint32_t current = 0;
+    uint32_t visited = 0;
+    while (true)
+    {
+        const auto &node = linearTree[current];
+        ++visited;
+        if (node.bounds.RayIntersect(ray, invDir))
+        {
+            if (node.isLeaf)
+            {
+                //叶子节点返回true时终止遍历
+                if (leafFunc(node)) break;
+                if (stackSize == 0) break;
+                current = stack[--stackSize];
+            }
+            else
+            {
+                //按射线方向先访问近处子节点，远处子节点入栈
+                if (dirIsNeg[node.axis])
+                {
+                    stack[stackSize++] = current + 1;
+                    current = node.secondChildOffset;
+                }
+                else
+                {
+                    stack[stackSize++] = node.secondChildOffset;
+                    current = current + 1;
+                }
+            }
+        }
+        else
+        {
+            if (stackSize == 0) break;
+            current = stack[--stackSize];
+        }
+    }
+    ACCEL_STATS_ADD(nodeVisits, visited);
+    return visited;
+}
+inline bool BVHAccel::IntersectLeaf(uint32_t primitivesOffset, uint32_t primitiveCount, const Ray &ray,
+                                    HitRecord &record, size_t &hitMesh, size_t &hitFace, bool isShadow) const
+{
+    bool isHit = false;
+    for (uint32_t i = 0; i < primitiveCount; ++i)
+    {
+        ACCEL_STATS_ADD(triangleTests, 1);
+        //优先使用预计算三角形进行相交测试
+        size_t meshIndex, faceIndex;
+        bool isFaceHit;
+        if (!triangles.empty())
+        {
+            const auto &triangle = triangles[primitivesOffset + i];
+            isFaceHit = triangle.RayIntersect(ray, record);
+            meshIndex = triangle.meshIndex;
+            faceIndex = triangle.faceIndex;
+        }
+        else
+        {
+            std::tie(meshIndex, faceIndex) = faceIndices[primitivesOffset + i];
+            isFaceHit = meshes[meshIndex]->RayIntersect(faceIndex, ray, record);
+        }
+        if (isFaceHit)
+        {
+            hitMesh = meshIndex;
+            hitFace = faceIndex;
+            isHit = true;
+            //阴影测试击中直接返回
+            if (isShadow)
+            {
+                return true;
+            }
+        }
+    }
+    return isHit;
+}
+bool BVHAccel::Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const
+{
+    if (linearTree.empty())
+    {
+        return Accel::Intersect(ray, record, hitFace, isShadow);
+    }
+    size_t hitMesh = 0;
+    bool isHit = false;
+    TraverseLinear(ray, [&](const LinearBVHNode &node) {
+        if (IntersectLeaf(node.primitivesOffset, node.primitiveCount, ray, record, hitMesh, hitFace, isShadow))
+        {
+            isHit = true;
+            return isShadow;
+        }
+        return false;
+    });
+    if (isHit && !isShadow)
+    {
+        record.hitMesh = meshes[hitMesh];
+    }
+    return isHit;
+}
+inline bool BVHAccel::OccludedLeaf(uint32_t primitivesOffset, uint32_t primitiveCount, const Ray &ray) const
+{
+    for (uint32_t i = 0; i < primitiveCount; ++i)
+    {
+        ACCEL_STATS_ADD(triangleTests, 1);
+        if (!triangles.empty())
+        {
+            if (triangles[primitivesOffset + i].Occluded(ray))
+            {
+                return true;
+            }
+            continue;
+        }
+        //未预计算时临时构造三角形
+        auto [meshIndex, faceIndex] = faceIndices[primitivesOffset + i];
+        const auto &mesh = meshes[meshIndex];
+        auto [idx0, idx1, idx2] = mesh->GetTriangleIndices(faceIndex);
+        PrecomputedTriangle triangle(mesh->positions[idx0], mesh->positions[idx1], mesh->positions[idx2], 0, 0);
+        if (triangle.Occluded(ray))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+bool BVHAccel::Occluded(const Ray &ray, float tMax) const
+{
+    if (linearTree.empty())
+    {
+        return Accel::Occluded(ray, tMax);
+    }
+    Ray shadowRay = ray;
+    shadowRay.tMax = std::min(ray.tMax, tMax);
+    bool isOccluded = false;
+    //找到任意交点即终止遍历
+    TraverseLinear(shadowRay, [&](const LinearBVHNode &node) {
+        isOccluded = OccludedLeaf(node.primitivesOffset, node.primitiveCount, shadowRay);
+        return isOccluded;
+    });
+    return isOccluded;
+}
+uint32_t BVHAccel::IntersectPacket8(const Ray *rays, HitRecord *records, size_t *hitFaces, int count) const
+{
+    if (linearTree.empty())
+    {
+        return Accel::IntersectPacket8(rays, records, hitFaces, count);
+    }
+    RayPacket8 packet(rays, count);
+    size_t hitMeshes[RayPacket8::kSize] = {};
+    uint32_t hitMask = 0;
+    //栈中同时保存节点与进入该节点时仍然有效的射线掩码
+    uint32_t stack[kMaxStackSize];
+    uint32_t maskStack[kMaxStackSize];
+    int stackSize = 0;
+    uint32_t current = 0;
+    uint32_t activeMask = (1u << count) - 1;
+    while (true)
+    {
+        const auto &node = linearTree[current];
+        //一次射线包节点测试计为一次访问
+        ACCEL_STATS_ADD(nodeVisits, 1);
+        //整个射线包都未击中时跳过该节点
+        uint32_t mask = activeMask & packet.IntersectBounds(node.bounds);
+        if (mask != 0)
+        {
+            if (node.isLeaf)
+            {
+                //叶子节点内逐条射线求交，并更新射线包的最近距离
+                for (int i = 0; i < count; ++i)
+                {
+                    if ((mask & (1u << i)) &&
+                        IntersectLeaf(node.primitivesOffset, node.primitiveCount,
+                                      rays[i], records[i], hitMeshes[i], hitFaces[i], false))
+                    {
+                        hitMask |= 1u << i;
+                        packet.tMax[i] = rays[i].tMax;
+                    }
+                }
+            }
+            else
+            {
+                //按第一条有效射线的方向确定访问顺序
+                int first = 0;
+                while (!(mask & (1u << first))) ++first;
+                const float *invDir = node.axis == 0 ? packet.invDirX :
+                                      node.axis == 1 ? packet.invDirY : packet.invDirZ;
+                if (invDir[first] < 0)
+                {
+                    stack[stackSize] = current + 1;
+                    current = node.secondChildOffset;
+                }
+                else
+                {
+                    stack[stackSize] = node.secondChildOffset;
+                    current = current + 1;
+                }
+                maskStack[stackSize++] = mask;
+                activeMask = mask;
+                continue;
+            }
+        }
+        if (stackSize == 0) break;
+        current = stack[--stackSize];
+        activeMask = maskStack[stackSize];
+    }
+    for (int i = 0; i < count; ++i)
+    {
+        if (hitMask & (1u << i))
+        {
+            records[i].hitMesh = meshes[hitMeshes[i]];
+        }
+    }
+    return hitMask;
+}
\ No newline at end of file
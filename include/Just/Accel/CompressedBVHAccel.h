@@ -0,0 +1,472 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Accel/BVHAccel.h"
+
+//压缩BVH节点，两个子节点的包围盒以8位整数相对父节点包围盒量化，叶子子节点直接存放在父节点中
+struct CompressedBVHNode
+{
+    //内部子节点的图元数量标记
+    static constexpr uint16_t kInternalChild = 0xFFFF;
+    uint8_t qMin[2][3];
+    uint8_t qMax[2][3];
+    //叶子子节点：图元起始位置；内部子节点：节点位置
+    uint32_t children[2];
+    //叶子子节点的图元数量，内部子节点为kInternalChild
+    uint16_t primitiveCounts[2];
+    CompressedBVHNode() : qMin(), qMax(), children(), primitiveCounts() {}
+};
+static_assert(sizeof(CompressedBVHNode) == 24, "CompressedBVHNode should be 24 bytes");
+
+//量化坐标系：最小点与每个量化单位的长度，使用普通数组使遍历栈无需初始化
+struct QuantizedFrame
+{
+    float origin[3];
+    float scale[3];
+    QuantizedFrame() = default;
+    explicit QuantizedFrame(const Bounds3f &bounds);
+    //解码子节点包围盒，构建与遍历必须使用同一计算以保证包围盒保守
+    Bounds3f Decode(const uint8_t *qMin, const uint8_t *qMax) const;
+};
+
+inline QuantizedFrame::QuantizedFrame(const Bounds3f &bounds)
+{
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        origin[axis] = bounds.pMin[axis];
+        //略微放大单位长度，保证255个单位覆盖整个包围盒
+        scale[axis] = (bounds.pMax[axis] - bounds.pMin[axis]) * (1.0f / 255.0f) * (1.0f + 1e-5f);
+    }
+}
+inline Bounds3f QuantizedFrame::Decode(const uint8_t *qMin, const uint8_t *qMax) const
+{
+    Bounds3f ret;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        ret.pMin[axis] = origin[axis] + static_cast<float>(qMin[axis]) * scale[axis];
+        ret.pMax[axis] = origin[axis] + static_cast<float>(qMax[axis]) * scale[axis];
+    }
+    return ret;
+}
+
+//压缩BVH：先构建二叉BVH，再量化为紧凑节点，图元以32位索引存放在共享数组中
+//未预计算三角形时每个三角形只占4字节索引，求交时访问网格数据
+struct CompressedBVHAccel : public BVHAccel
+{
+public:
+    explicit CompressedBVHAccel(int nums = 16, int depth = 32) : BVHAccel(nums, depth)
+    {
+        isPrecomputed = false;
+        //kInternalChild标记内部子节点，叶子图元数量必须小于该值
+        maxLeafSize = CompressedBVHNode::kInternalChild - 1;
+    }
+    ~CompressedBVHAccel() override = default;
+    virtual void Build() override;
+    //量化节点不能原地更新，重新构建
+    virtual void Refit(size_t meshIndex) override;
+    virtual bool Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const override;
+    virtual bool Occluded(const Ray &ray, float tMax) const override;
+    virtual uint32_t IntersectPacket8(const Ray *rays, HitRecord *records, size_t *hitFaces, int count) const override
+    {
+        return Accel::IntersectPacket8(rays, records, hitFaces, count);
+    }
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const override;
+    virtual AccelStats CollectStats() const override;
+    //压缩后不保留二叉树，不缓存
+    virtual bool SaveCache(const std::string &path) const override { return false; }
+    virtual bool LoadCache(const std::string &path) override { return false; }
+    //节点、图元索引与预计算三角形占用的内存
+    size_t MemoryUsage() const;
+private:
+    void Compress();
+    uint32_t CompressNode(uint32_t binaryIndex, const QuantizedFrame &frame);
+    //栈式深度优先遍历，叶子子节点交给leafFunc处理
+    template<typename LeafFunc>
+    void TraverseCompressed(const Ray &ray, LeafFunc &&leafFunc) const;
+    //全局图元索引转换为网格与面索引
+    std::pair<size_t, size_t> DecodePrimitive(uint32_t primitive) const;
+public:
+    std::vector<CompressedBVHNode> compressedTree;
+    //根节点的量化坐标系
+    QuantizedFrame rootFrame;
+    //按叶子顺序排列的全局图元索引，预计算三角形时为空
+    std::vector<uint32_t> primitiveIndices;
+    //每个网格第一个面的全局图元索引
+    std::vector<uint32_t> meshFaceOffsets;
+};
+
+void CompressedBVHAccel::Build()
+{
+    //压缩后不保留faceIndices，重新构建时从网格生成
+    if (faceIndices.empty())
+    {
+        for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex)
+        {
+            for (size_t faceIndex = 0; faceIndex < meshes[meshIndex]->GetTriangleCount(); ++faceIndex)
+            {
+                faceIndices.emplace_back(meshIndex, faceIndex);
+            }
+        }
+    }
+    isLinear = true;
+    buildMethod = BVHBuildMethod::BinnedSAH;
+    BVHAccel::Build();
+    Compress();
+}
+void CompressedBVHAccel::Refit(size_t meshIndex)
+{
+    meshes[meshIndex]->UpdateBounds();
+    bounds = Bounds3f();
+    for (const auto &mesh: meshes)
+    {
+        bounds.Expand(mesh->bounds);
+    }
+    Build();
+}
+void CompressedBVHAccel::Compress()
+{
+    compressedTree.clear();
+    primitiveIndices.clear();
+    meshFaceOffsets.clear();
+    if (linearTree.empty())
+    {
+        return;
+    }
+    meshFaceOffsets.resize(meshes.size() + 1, 0);
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        meshFaceOffsets[i + 1] = meshFaceOffsets[i] + static_cast<uint32_t>(meshes[i]->GetTriangleCount());
+    }
+    if (triangles.empty())
+    {
+        primitiveIndices.resize(faceIndices.size());
+        for (size_t i = 0; i < faceIndices.size(); ++i)
+        {
+            auto [meshIndex, faceIndex] = faceIndices[i];
+            primitiveIndices[i] = meshFaceOffsets[meshIndex] + static_cast<uint32_t>(faceIndex);
+        }
+    }
+    compressedTree.reserve(linearTree.size() / 2 + 1);
+    rootFrame = QuantizedFrame(linearTree[0].bounds);
+    if (linearTree[0].isLeaf)
+    {
+        //根节点为叶子时，第二个子节点为空叶子
+        auto &root = compressedTree.emplace_back();
+        std::fill(&root.qMax[0][0], &root.qMax[0][0] + 3, static_cast<uint8_t>(255));
+        root.children[0] = linearTree[0].primitivesOffset;
+        root.primitiveCounts[0] = linearTree[0].primitiveCount;
+    }
+    else
+    {
+        CompressNode(0, rootFrame);
+    }
+    nodeCount = static_cast<int>(compressedTree.size());
+    //二叉树与面索引已编码进压缩数据
+    linearTree.clear();
+    linearTree.shrink_to_fit();
+    faceIndices.clear();
+    faceIndices.shrink_to_fit();
+    size_t triangleCount = meshFaceOffsets.back();
+    std::cout << "[compressed node count]: " << compressedTree.size() << std::endl;
+    std::cout << "[bytes per triangle]: "
+              << static_cast<float>(MemoryUsage()) / static_cast<float>(std::max<size_t>(triangleCount, 1))
+              << std::endl;
+}
+uint32_t CompressedBVHAccel::CompressNode(uint32_t binaryIndex, const QuantizedFrame &frame)
+{
+    auto compressedIndex = static_cast<uint32_t>(compressedTree.size());
+    compressedTree.emplace_back();
+    const uint32_t binaryChildren[2] = {binaryIndex + 1, linearTree[binaryIndex].secondChildOffset};
+    for (int c = 0; c < 2; ++c)
+    {
+        const auto &child = linearTree[binaryChildren[c]];
+        uint8_t qMin[3], qMax[3];
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float scale = frame.scale[axis];
+            int lo = 0, hi = 0;
+            if (scale > 0.0f)
+            {
+                float lower = std::floor((child.bounds.pMin[axis] - frame.origin[axis]) / scale);
+                float upper = std::ceil((child.bounds.pMax[axis] - frame.origin[axis]) / scale);
+                lo = std::clamp(static_cast<int>(lower), 0, 255);
+                hi = std::clamp(static_cast<int>(upper), 0, 255);
+                //舍入误差可能使解码后的包围盒略小于原包围盒，逐步放宽
+                while (lo > 0 && frame.origin[axis] + static_cast<float>(lo) * scale > child.bounds.pMin[axis])
+                {
+                    --lo;
+                }
+                while (hi < 255 && frame.origin[axis] + static_cast<float>(hi) * scale < child.bounds.pMax[axis])
+                {
+                    ++hi;
+                }
+            }
+            qMin[axis] = static_cast<uint8_t>(lo);
+            qMax[axis] = static_cast<uint8_t>(hi);
+        }
+        //内部子节点以解码后的包围盒作为坐标系，保证子树包围盒逐层保守
+        uint32_t target = child.isLeaf ? child.primitivesOffset
+                                       : CompressNode(binaryChildren[c], QuantizedFrame(frame.Decode(qMin, qMax)));
+        auto &node = compressedTree[compressedIndex];
+        std::copy(qMin, qMin + 3, node.qMin[c]);
+        std::copy(qMax, qMax + 3, node.qMax[c]);
+        node.children[c] = target;
+        node.primitiveCounts[c] = child.isLeaf ? child.primitiveCount : CompressedBVHNode::kInternalChild;
+    }
+    return compressedIndex;
+}
+std::pair<size_t, size_t> CompressedBVHAccel::DecodePrimitive(uint32_t primitive) const
+{
+    auto it = std::upper_bound(meshFaceOffsets.begin(), meshFaceOffsets.end(), primitive);
+    auto meshIndex = static_cast<size_t>(it - meshFaceOffsets.begin()) - 1;
+    return {meshIndex, primitive - meshFaceOffsets[meshIndex]};
+}
+size_t CompressedBVHAccel::MemoryUsage() const
+{
+    return compressedTree.size() * sizeof(CompressedBVHNode) +
+           primitiveIndices.size() * sizeof(uint32_t) +
+           meshFaceOffsets.size() * sizeof(uint32_t) +
+           triangles.size() * sizeof(PrecomputedTriangle);
+}
+template<typename LeafFunc>
+void CompressedBVHAccel::TraverseCompressed(const Ray &ray, LeafFunc &&leafFunc) const
+{
+    //栈中保存子节点、进入距离与解码后的坐标系，出栈时进入距离超过当前最近交点则跳过
+    struct StackEntry
+    {
+        uint32_t index;
+        uint32_t primitiveCount;
+        float tNear;
+        QuantizedFrame frame;
+    };
+    Vector3f invDir = 1.0f / ray.direction;
+    StackEntry stack[2 * kMaxStackSize];
+    int stackSize = 0;
+    StackEntry current = {0, CompressedBVHNode::kInternalChild, ray.tMin, rootFrame};
+    uint32_t visited = 0;
+    while (true)
+    {
+        if (current.primitiveCount != CompressedBVHNode::kInternalChild)
+        {
+            //叶子子节点返回true时终止遍历
+            if (leafFunc(current.index, current.primitiveCount)) break;
+        }
+        else
+        {
+            const auto &node = compressedTree[current.index];
+            ++visited;
+            //量化坐标直接变换到射线参数空间，每个平面只需一次乘加
+            float tOrigin[3], tScale[3];
+            for (int axis = 0; axis < 3; ++axis)
+            {
+                tOrigin[axis] = (current.frame.origin[axis] - ray.origin[axis]) * invDir[axis];
+                tScale[axis] = current.frame.scale[axis] * invDir[axis];
+            }
+            StackEntry children[2];
+            bool isChildHit[2];
+            for (int c = 0; c < 2; ++c)
+            {
+                float near = ray.tMin, far = ray.tMax;
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    float t0 = tOrigin[axis] + static_cast<float>(node.qMin[c][axis]) * tScale[axis];
+                    float t1 = tOrigin[axis] + static_cast<float>(node.qMax[c][axis]) * tScale[axis];
+                    if (t0 > t1) std::swap(t0, t1);
+                    near = t0 > near ? t0 : near;
+                    far = t1 < far ? t1 : far;
+                }
+                isChildHit[c] = near <= far;
+                children[c].index = node.children[c];
+                children[c].primitiveCount = node.primitiveCounts[c];
+                children[c].tNear = near;
+                if (isChildHit[c] && node.primitiveCounts[c] == CompressedBVHNode::kInternalChild)
+                {
+                    children[c].frame = QuantizedFrame(current.frame.Decode(node.qMin[c], node.qMax[c]));
+                }
+            }
+            //先访问近处子节点，远处子节点入栈
+            if (isChildHit[0] && isChildHit[1])
+            {
+                int first = children[1].tNear < children[0].tNear ? 1 : 0;
+                stack[stackSize++] = children[1 - first];
+                current = children[first];
+                continue;
+            }
+            if (isChildHit[0] || isChildHit[1])
+            {
+                current = children[isChildHit[0] ? 0 : 1];
+                continue;
+            }
+        }
+        while (stackSize > 0 && stack[stackSize - 1].tNear > ray.tMax)
+        {
+            --stackSize;
+        }
+        if (stackSize == 0) break;
+        current = stack[--stackSize];
+    }
+    ACCEL_STATS_ADD(nodeVisits, visited);
+}
+bool CompressedBVHAccel::Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const
+{
+    if (compressedTree.empty())
+    {
+        return false;
+    }
+    size_t hitMesh = 0;
+    bool isHit = false;
+    TraverseCompressed(ray, [&](uint32_t primitivesOffset, uint32_t primitiveCount) {
+        if (!triangles.empty())
+        {
+            if (IntersectLeaf(primitivesOffset, primitiveCount, ray, record, hitMesh, hitFace, isShadow))
+            {
+                isHit = true;
+                return isShadow;
+            }
+            return false;
+        }
+        for (uint32_t i = 0; i < primitiveCount; ++i)
+        {
+            ACCEL_STATS_ADD(triangleTests, 1);
+            auto [meshIndex, faceIndex] = DecodePrimitive(primitiveIndices[primitivesOffset + i]);
+            if (meshes[meshIndex]->RayIntersect(faceIndex, ray, record))
+            {
+                hitMesh = meshIndex;
+                hitFace = faceIndex;
+                isHit = true;
+                //阴影测试击中直接返回
+                if (isShadow)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+    if (isHit && !isShadow)
+    {
+        record.hitMesh = meshes[hitMesh];
+    }
+    return isHit;
+}
+bool CompressedBVHAccel::Occluded(const Ray &ray, float tMax) const
+{
+    if (compressedTree.empty())
+    {
+        return false;
+    }
+    Ray shadowRay = ray;
+    shadowRay.tMax = std::min(ray.tMax, tMax);
+    bool isOccluded = false;
+    TraverseCompressed(shadowRay, [&](uint32_t primitivesOffset, uint32_t primitiveCount) {
+        if (!triangles.empty())
+        {
+            isOccluded = OccludedLeaf(primitivesOffset, primitiveCount, shadowRay);
+            return isOccluded;
+        }
+        for (uint32_t i = 0; i < primitiveCount; ++i)
+        {
+            ACCEL_STATS_ADD(triangleTests, 1);
+            auto [meshIndex, faceIndex] = DecodePrimitive(primitiveIndices[primitivesOffset + i]);
+            const auto &mesh = meshes[meshIndex];
+            auto [idx0, idx1, idx2] = mesh->GetTriangleIndices(faceIndex);
+            PrecomputedTriangle triangle(mesh->positions[idx0], mesh->positions[idx1], mesh->positions[idx2], 0, 0);
+            if (triangle.Occluded(shadowRay))
+            {
+                isOccluded = true;
+                return true;
+            }
+        }
+        return false;
+    });
+    return isOccluded;
+}
+void CompressedBVHAccel::StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
+{
+    if (compressedTree.empty())
+    {
+        return;
+    }
+    struct StackEntry
+    {
+        uint32_t index;
+        uint32_t planeMask;
+        QuantizedFrame frame;
+    };
+    StackEntry stack[kMaxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = {0, Frustum::kAllPlanes, rootFrame};
+    while (stackSize > 0)
+    {
+        auto current = stack[--stackSize];
+        const auto &node = compressedTree[current.index];
+        for (int c = 0; c < 2; ++c)
+        {
+            Bounds3f childBounds = current.frame.Decode(node.qMin[c], node.qMax[c]);
+            uint32_t planeMask = current.planeMask;
+            if (planeMask != 0 && !frustum.Intersect(childBounds, planeMask))
+            {
+                continue;
+            }
+            if (node.primitiveCounts[c] == CompressedBVHNode::kInternalChild)
+            {
+                stack[stackSize++] = {node.children[c], planeMask, QuantizedFrame(childBounds)};
+                continue;
+            }
+            for (uint32_t i = 0; i < node.primitiveCounts[c]; ++i)
+            {
+                uint32_t offset = node.children[c] + i;
+                if (!triangles.empty())
+                {
+                    visibleFaces.emplace_back(triangles[offset].meshIndex, triangles[offset].faceIndex);
+                }
+                else
+                {
+                    visibleFaces.push_back(DecodePrimitive(primitiveIndices[offset]));
+                }
+            }
+        }
+    }
+}
+AccelStats CompressedBVHAccel::CollectStats() const
+{
+    AccelStats stats;
+    stats.type = ReadableTypeName(typeid(*this));
+    stats.nodeCount = static_cast<int>(compressedTree.size());
+    if (compressedTree.empty())
+    {
+        return stats;
+    }
+    //子节点总在父节点之后，正序遍历即可得到每个节点的深度与坐标系，成本按解码后的包围盒计算
+    std::vector<int> depths(compressedTree.size(), 0);
+    std::vector<QuantizedFrame> frames(compressedTree.size());
+    frames[0] = rootFrame;
+    float cost = 0.0f;
+    for (size_t i = 0; i < compressedTree.size(); ++i)
+    {
+        const auto &node = compressedTree[i];
+        Bounds3f nodeBounds;
+        for (int c = 0; c < 2; ++c)
+        {
+            Bounds3f childBounds = frames[i].Decode(node.qMin[c], node.qMax[c]);
+            nodeBounds.Expand(childBounds);
+            if (node.primitiveCounts[c] == CompressedBVHNode::kInternalChild)
+            {
+                depths[node.children[c]] = depths[i] + 1;
+                frames[node.children[c]] = QuantizedFrame(childBounds);
+            }
+            else
+            {
+                ++stats.leafCount;
+                stats.maxDepth = std::max(stats.maxDepth, depths[i] + 2);
+                stats.AddLeaf(node.primitiveCounts[c], depths[i] + 1);
+                cost += static_cast<float>(node.primitiveCounts[c]) * childBounds.SurfaceArea();
+            }
+        }
+        cost += kTraversalCost * nodeBounds.SurfaceArea();
+    }
+    uint8_t qMin[3] = {0, 0, 0}, qMax[3] = {255, 255, 255};
+    float rootArea = rootFrame.Decode(qMin, qMax).SurfaceArea();
+    stats.sahCost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+    return stats;
+}
\ No newline at end of file
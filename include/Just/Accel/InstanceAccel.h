@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Math/Transform.h"
+#include "Just/Accel/BVHAccel.h"
+
+//网格实例，共享网格的底层BVH，只保存自身变换
+struct Instance
+{
+    Transform transform;
+    //世界空间包围盒
+    Bounds3f bounds;
+    uint32_t meshIndex;
+    Instance() : meshIndex(0) {}
+    Instance(size_t meshIndex, const Transform &transform)
+            : transform(transform), meshIndex(static_cast<uint32_t>(meshIndex)) {}
+};
+
+//变换包围盒的八个拐角点后重新求包围盒
+inline Bounds3f TransformBounds(const Transform &transform, const Bounds3f &bounds)
+{
+    Bounds3f ret;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        ret.Expand(transform(Point4f(bounds.Corner(corner), 1.0f)));
+    }
+    return ret;
+}
+
+//两层加速结构：每个网格一棵底层BVH，顶层BVH的叶子为实例
+struct InstanceAccel : public BVHAccel
+{
+public:
+    explicit InstanceAccel(int nums = 2, int depth = 32) : BVHAccel(nums, depth) {}
+    ~InstanceAccel() override = default;
+    virtual void Reset() override;
+    virtual void Build() override;
+    virtual void Refit(size_t meshIndex) override;
+    virtual bool Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const override;
+    virtual bool Occluded(const Ray &ray, float tMax) const override;
+    //射线进入各实例的物体空间后不再共享，逐条求交
+    virtual uint32_t IntersectPacket8(const Ray *rays, HitRecord *records, size_t *hitFaces, int count) const override
+    {
+        return Accel::IntersectPacket8(rays, records, hitFaces, count);
+    }
+    virtual void Interpolate(HitRecord &record, size_t faceIndex) const override;
+    //光栅化不应用实例变换，网格按原坐标绘制，因此直接用各网格的底层BVH剔除
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const override;
+    //顶层叶子为实例而不是图元，只做视锥剔除
+    virtual void OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                                  const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const override
+    {
+        Accel::OcclusionCulling(frustum, isOccluded, visitLeaf);
+    }
+    //顶层随实例变换变化，不缓存
+    virtual bool SaveCache(const std::string &path) const override { return false; }
+    virtual bool LoadCache(const std::string &path) override { return false; }
+    //添加网格实例，返回实例索引
+    size_t AddInstance(size_t meshIndex, const Transform &transform);
+    //修改实例变换，修改完成后调用BuildTopLevel
+    void SetInstanceTransform(size_t instanceIndex, const Transform &transform);
+    //只重新构建顶层BVH
+    void BuildTopLevel();
+public:
+    //每个网格的底层BVH
+    std::vector<Ref<BVHAccel>> blases;
+    std::vector<Instance> instances;
+    //顶层叶子顺序到实例索引的映射
+    std::vector<uint32_t> instanceOrder;
+};
+
+void InstanceAccel::Reset()
+{
+    BVHAccel::Reset();
+    linearTree.clear();
+    linearTree.shrink_to_fit();
+    blases.clear();
+    instances.clear();
+    instanceOrder.clear();
+}
+size_t InstanceAccel::AddInstance(size_t meshIndex, const Transform &transform)
+{
+    instances.emplace_back(meshIndex, transform);
+    return instances.size() - 1;
+}
+void InstanceAccel::SetInstanceTransform(size_t instanceIndex, const Transform &transform)
+{
+    instances[instanceIndex].transform = transform;
+}
+void InstanceAccel::Build()
+{
+    std::cout << "[info]: building accel (instanced)......" << "\n";
+    //底层BVH只构建一次，由该网格的所有实例共享
+    for (size_t i = blases.size(); i < meshes.size(); ++i)
+    {
+        auto blas = CreateRef<BVHAccel>();
+        blas->AddMesh(meshes[i]);
+        blas->Build();
+        blases.push_back(blas);
+    }
+    //未添加实例时每个网格作为一个单位变换实例
+    if (instances.empty())
+    {
+        for (size_t i = 0; i < meshes.size(); ++i)
+        {
+            AddInstance(i, Transform());
+        }
+    }
+    //图元由底层BVH持有，顶层不需要
+    faceIndices.clear();
+    faceIndices.shrink_to_fit();
+    BuildTopLevel();
+}
+void InstanceAccel::BuildTopLevel()
+{
+    linearTree.clear();
+    bounds = Bounds3f();
+    if (instances.empty())
+    {
+        return;
+    }
+    //计算实例的世界空间包围盒
+    auto count = static_cast<uint32_t>(instances.size());
+    primitiveInfos.resize(count);
+    primitiveOrder.resize(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        auto &instance = instances[i];
+        instance.bounds = TransformBounds(instance.transform, blases[instance.meshIndex]->bounds);
+        primitiveInfos[i].bounds = instance.bounds;
+        primitiveInfos[i].centroid = instance.bounds.Centroid();
+        primitiveOrder[i] = static_cast<uint32_t>(i);
+    }
+    linearTree.reserve(2 * count / std::max(minNumFaces, 1) + 1);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+    BuildBinned(0, count, 0, linearTree);
+    //叶子记录的是primitiveOrder中的范围，保留为实例映射，实例数组本身顺序不变
+    instanceOrder.swap(primitiveOrder);
+    primitiveInfos.clear();
+    primitiveInfos.shrink_to_fit();
+    primitiveOrder.clear();
+    bounds = linearTree[0].bounds;
+    buildCost = SAHCost();
+    CountLinearTree();
+    std::cout << "[instance count]: " << count << std::endl;
+    std::cout << "[top level node count]: " << nodeCount << std::endl;
+}
+void InstanceAccel::Refit(size_t meshIndex)
+{
+    //更新网格的底层BVH后重新构建顶层
+    blases[meshIndex]->Refit(0);
+    BuildTopLevel();
+}
+bool InstanceAccel::Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const
+{
+    if (linearTree.empty())
+    {
+        return false;
+    }
+    bool isHit = false;
+    TraverseLinear(ray, [&](const LinearBVHNode &node) {
+        for (uint32_t i = 0; i < node.primitiveCount; ++i)
+        {
+            uint32_t instanceIndex = instanceOrder[node.primitivesOffset + i];
+            const auto &instance = instances[instanceIndex];
+            //射线变换到物体空间，方向不归一化以保持参数t与世界空间一致
+            Ray localRay;
+            localRay.origin = Point3f(instance.transform.inverse * Point4f(ray.origin, 1.0f));
+            localRay.direction = instance.transform.inverse * ray.direction;
+            localRay.tMin = ray.tMin;
+            localRay.tMax = ray.tMax;
+            if (blases[instance.meshIndex]->Intersect(localRay, record, hitFace, isShadow))
+            {
+                isHit = true;
+                //阴影测试击中直接返回
+                if (isShadow)
+                {
+                    return true;
+                }
+                ray.tMax = localRay.tMax;
+                record.hitInstance = instanceIndex;
+            }
+        }
+        return false;
+    });
+    return isHit;
+}
+bool InstanceAccel::Occluded(const Ray &ray, float tMax) const
+{
+    if (linearTree.empty())
+    {
+        return false;
+    }
+    Ray shadowRay = ray;
+    shadowRay.tMax = std::min(ray.tMax, tMax);
+    bool isOccluded = false;
+    TraverseLinear(shadowRay, [&](const LinearBVHNode &node) {
+        for (uint32_t i = 0; i < node.primitiveCount; ++i)
+        {
+            const auto &instance = instances[instanceOrder[node.primitivesOffset + i]];
+            Ray localRay;
+            localRay.origin = Point3f(instance.transform.inverse * Point4f(shadowRay.origin, 1.0f));
+            localRay.direction = instance.transform.inverse * shadowRay.direction;
+            localRay.tMin = shadowRay.tMin;
+            localRay.tMax = shadowRay.tMax;
+            if (blases[instance.meshIndex]->Occluded(localRay, localRay.tMax))
+            {
+                isOccluded = true;
+                return true;
+            }
+        }
+        return false;
+    });
+    return isOccluded;
+}
+void InstanceAccel::StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
+{
+    std::vector<std::pair<size_t, size_t>> meshFaces;
+    for (size_t meshIndex = 0; meshIndex < blases.size(); ++meshIndex)
+    {
+        meshFaces.clear();
+        blases[meshIndex]->StaticCulling(frustum, meshFaces);
+        //底层BVH只包含一个网格
+        for (auto [m, faceIndex]: meshFaces)
+        {
+            visibleFaces.emplace_back(meshIndex, faceIndex);
+        }
+    }
+}
+void InstanceAccel::Interpolate(HitRecord &record, size_t faceIndex) const
+{
+    //在物体空间插值，再变换到世界空间
+    Accel::Interpolate(record, faceIndex);
+    const auto &transform = instances[record.hitInstance].transform;
+    record.hitPoint = transform(Point4f(record.hitPoint, 1.0f));
+    //法线使用逆转置矩阵变换
+    Matrix4f normalMatrix = Transpose(transform.inverse);
+    record.geoFrame = Frame(Normalize(normalMatrix * record.geoFrame.n));
+    record.shFrame = Frame(Normalize(normalMatrix * record.shFrame.n));
+}
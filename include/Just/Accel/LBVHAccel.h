@@ -0,0 +1,254 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Accel/BVHAccel.h"
+
+//莫顿码排序后的图元
+struct MortonPrimitive
+{
+    uint32_t code;
+    uint32_t index;
+};
+
+//10位整数的每一位之间插入两个0
+inline uint32_t LeftShift3(uint32_t x)
+{
+    x = (x * 0x00010001u) & 0xFF0000FFu;
+    x = (x * 0x00000101u) & 0x0F00F00Fu;
+    x = (x * 0x00000011u) & 0xC30C30C3u;
+    x = (x * 0x00000005u) & 0x49249249u;
+    return x;
+}
+//[0,1]范围内的点编码为30位莫顿码，x在最高位
+inline uint32_t EncodeMorton3(const Vector3f &p)
+{
+    auto x = static_cast<uint32_t>(std::clamp(p.x * 1024.0f, 0.0f, 1023.0f));
+    auto y = static_cast<uint32_t>(std::clamp(p.y * 1024.0f, 0.0f, 1023.0f));
+    auto z = static_cast<uint32_t>(std::clamp(p.z * 1024.0f, 0.0f, 1023.0f));
+    return (LeftShift3(x) << 2) | (LeftShift3(y) << 1) | LeftShift3(z);
+}
+//最高有效位
+inline int HighestBit(uint32_t x)
+{
+    int bit = -1;
+    while (x)
+    {
+        x >>= 1;
+        ++bit;
+    }
+    return bit;
+}
+
+//线性BVH，按质心莫顿码排序后逐位划分，适合动态场景的快速重建
+struct LBVHAccel : public BVHAccel
+{
+private:
+    //基数排序每趟位数
+    static constexpr int kRadixBits = 8;
+    static constexpr int kRadixSize = 1 << kRadixBits;
+    //基数排序分块数量
+    static constexpr int kNumSortChunks = 64;
+public:
+    explicit LBVHAccel(int nums = 16, int depth = 32) : BVHAccel(nums, depth) {}
+    ~LBVHAccel() override = default;
+    virtual void Build() override;
+    //按30位莫顿码稳定排序，也用于射线流排序
+    static void RadixSort(std::vector<MortonPrimitive> &primitives);
+private:
+    uint32_t Emit(uint32_t begin, uint32_t end, int depth, std::vector<LinearBVHNode> &nodes);
+private:
+    std::vector<MortonPrimitive> mortonPrimitives;
+};
+
+void LBVHAccel::Build()
+{
+    std::cout << "[info]: building accel (LBVH)......" << "\n";
+    std::cout << "[mesh count]:" << meshes.size() << "\n";
+    std::cout << "[triangle count]:" << faceIndices.size() << "\n";
+    linearTree.clear();
+    if (faceIndices.empty())
+    {
+        return;
+    }
+    //场景包围盒内归一化质心并计算莫顿码
+    auto count = static_cast<uint32_t>(faceIndices.size());
+    primitiveInfos.resize(count);
+    primitiveOrder.resize(count);
+    mortonPrimitives.resize(count);
+    Vector3f diagonal = bounds.Diagonal();
+    Vector3f invDiagonal;
+    for (int d = 0; d < 3; ++d)
+    {
+        invDiagonal[d] = diagonal[d] > 0.0f ? 1.0f / diagonal[d] : 0.0f;
+    }
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        auto [meshIndex, faceIndex] = faceIndices[i];
+        primitiveInfos[i].bounds = meshes[meshIndex]->GetFaceBounds(faceIndex);
+        primitiveInfos[i].centroid = primitiveInfos[i].bounds.Centroid();
+        mortonPrimitives[i].code = EncodeMorton3((primitiveInfos[i].centroid - bounds.pMin) * invDiagonal);
+        mortonPrimitives[i].index = static_cast<uint32_t>(i);
+    }
+    //按莫顿码排序
+    RadixSort(mortonPrimitives);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        primitiveOrder[i] = mortonPrimitives[i].index;
+    }
+    //自顶向下按莫顿码最高不同位划分，节点按深度优先顺序写入
+    linearTree.reserve(2 * count / std::max(minNumFaces, 1) + 1);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel
+#pragma omp single
+#endif
+    Emit(0, count, 0, linearTree);
+    //按叶子顺序重排图元
+    std::vector<std::pair<size_t, size_t>> orderedFaces(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        orderedFaces[i] = faceIndices[primitiveOrder[i]];
+    }
+    faceIndices.swap(orderedFaces);
+    primitiveInfos.clear();
+    primitiveInfos.shrink_to_fit();
+    primitiveOrder.clear();
+    primitiveOrder.shrink_to_fit();
+    mortonPrimitives.clear();
+    mortonPrimitives.shrink_to_fit();
+    FinishLinearBuild();
+    //统计数据
+    CountLinearTree();
+    std::cout << "[tree depth]: " << currDepth << std::endl;
+    std::cout << "[node count]: " << nodeCount << std::endl;
+    std::cout << "[leaf count]: " << leafCount << std::endl;
+}
+void LBVHAccel::RadixSort(std::vector<MortonPrimitive> &primitives)
+{
+    //LSD基数排序，每块独立统计直方图后并行分发，结果稳定
+    auto count = primitives.size();
+    std::vector<MortonPrimitive> temp(count);
+    size_t chunkSize = (count + kNumSortChunks - 1) / kNumSortChunks;
+    std::vector<uint32_t> offsets(kNumSortChunks * kRadixSize);
+    for (int lowBit = 0; lowBit < 30; lowBit += kRadixBits)
+    {
+        std::fill(offsets.begin(), offsets.end(), 0);
+        //分块统计
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int chunk = 0; chunk < kNumSortChunks; ++chunk)
+        {
+            size_t begin = std::min(count, chunk * chunkSize);
+            size_t end = std::min(count, begin + chunkSize);
+            uint32_t *histogram = &offsets[chunk * kRadixSize];
+            for (size_t i = begin; i < end; ++i)
+            {
+                ++histogram[(primitives[i].code >> lowBit) & (kRadixSize - 1)];
+            }
+        }
+        //按桶优先、块其次的顺序计算写入位置
+        uint32_t sum = 0;
+        for (int bucket = 0; bucket < kRadixSize; ++bucket)
+        {
+            for (int chunk = 0; chunk < kNumSortChunks; ++chunk)
+            {
+                uint32_t n = offsets[chunk * kRadixSize + bucket];
+                offsets[chunk * kRadixSize + bucket] = sum;
+                sum += n;
+            }
+        }
+        //分块分发
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+        for (int chunk = 0; chunk < kNumSortChunks; ++chunk)
+        {
+            size_t begin = std::min(count, chunk * chunkSize);
+            size_t end = std::min(count, begin + chunkSize);
+            uint32_t *offset = &offsets[chunk * kRadixSize];
+            for (size_t i = begin; i < end; ++i)
+            {
+                temp[offset[(primitives[i].code >> lowBit) & (kRadixSize - 1)]++] = primitives[i];
+            }
+        }
+        primitives.swap(temp);
+    }
+}
+uint32_t LBVHAccel::Emit(uint32_t begin, uint32_t end, int depth, std::vector<LinearBVHNode> &nodes)
+{
+    auto offset = static_cast<uint32_t>(nodes.size());
+    nodes.emplace_back();
+    uint32_t count = end - begin;
+    //叶子图元数量受节点字段宽度限制
+    bool canBeLeaf = count <= maxLeafSize;
+    if (canBeLeaf && (count <= static_cast<uint32_t>(minNumFaces) || depth >= maxDepth))
+    {
+        Bounds3f leafBounds;
+        for (uint32_t i = begin; i < end; ++i)
+        {
+            leafBounds.Expand(primitiveInfos[primitiveOrder[i]].bounds);
+        }
+        nodes[offset].bounds = leafBounds;
+        nodes[offset].isLeaf = 1;
+        nodes[offset].primitivesOffset = begin;
+        nodes[offset].primitiveCount = static_cast<uint16_t>(count);
+        return offset;
+    }
+
+    //在首尾莫顿码的最高不同位处划分，该位为0的图元在左侧
+    uint32_t first = mortonPrimitives[begin].code;
+    uint32_t last = mortonPrimitives[end - 1].code;
+    uint32_t mid = begin + count / 2;
+    int axis = 0;
+    if (first != last)
+    {
+        int bit = HighestBit(first ^ last);
+        auto it = std::partition_point(
+                mortonPrimitives.begin() + begin,
+                mortonPrimitives.begin() + end,
+                [bit](const MortonPrimitive &p) { return (p.code & (1u << bit)) == 0; }
+        );
+        mid = static_cast<uint32_t>(it - mortonPrimitives.begin());
+        //x、y、z依次交错，最低位为z
+        axis = 2 - bit % 3;
+    }
+    nodes[offset].axis = static_cast<uint8_t>(axis);
+
+    //第一个子节点紧跟父节点，大节点的子树并行构建
+    Bounds3f leftBounds, rightBounds;
+    if (count < kParallelThreshold)
+    {
+        uint32_t left = Emit(begin, mid, depth + 1, nodes);
+        uint32_t right = Emit(mid, end, depth + 1, nodes);
+        leftBounds = nodes[left].bounds;
+        rightBounds = nodes[right].bounds;
+        nodes[offset].secondChildOffset = right;
+    }
+    else
+    {
+        std::vector<LinearBVHNode> leftNodes, rightNodes;
+#ifdef ENABLE_OPENMP
+#pragma omp task shared(leftNodes) firstprivate(begin, mid, depth)
+#endif
+        Emit(begin, mid, depth + 1, leftNodes);
+#ifdef ENABLE_OPENMP
+#pragma omp task shared(rightNodes) firstprivate(mid, end, depth)
+#endif
+        Emit(mid, end, depth + 1, rightNodes);
+#ifdef ENABLE_OPENMP
+#pragma omp taskwait
+#endif
+        leftBounds = leftNodes[0].bounds;
+        rightBounds = rightNodes[0].bounds;
+        AppendSubtree(nodes, leftNodes);
+        nodes[offset].secondChildOffset = AppendSubtree(nodes, rightNodes);
+    }
+    nodes[offset].bounds = Union(leftBounds, rightBounds);
+    return offset;
+}
@@ -10,7 +10,7 @@ public:
     ~NaiveAccel() override = default;
     virtual void Divide(size_t nodeIndex, std::vector<AccelNode> &children) override;
     virtual void Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t> &queue) const override;
-    virtual void StaticCulling() override;
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const override;
 };
 
 void NaiveAccel::Divide(size_t nodeIndex, std::vector<AccelNode> &children)
@@ -19,7 +19,19 @@ void NaiveAccel::Divide(size_t nodeIndex, std::vector<AccelNode> &children)
 void NaiveAccel::Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t> &queue) const
 {
 }
-void NaiveAccel::StaticCulling()
+void NaiveAccel::StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
 {
+    //没有层次结构，只按网格包围盒剔除
+    for (size_t meshIndex = 0; meshIndex < meshes.size(); ++meshIndex)
+    {
+        if (!frustum.Intersect(meshes[meshIndex]->bounds))
+        {
+            continue;
+        }
+        for (size_t faceIndex = 0; faceIndex < meshes[meshIndex]->GetTriangleCount(); ++faceIndex)
+        {
+            visibleFaces.emplace_back(meshIndex, faceIndex);
+        }
+    }
 }
 
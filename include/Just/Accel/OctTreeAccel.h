@@ -2,17 +2,194 @@
 
 #include "Just/Common.h"
 #include "Just/Core/Accel.h"
+#include "Just/Geometry/Triangle.h"
+
+//稀疏八叉树节点，只保存非空子节点，子节点连续存放
+struct OctreeNode
+{
+    //紧包围盒，限制在节点所在的八分体内
+    Bounds3f bounds;
+    union
+    {
+        uint32_t primitivesOffset; //叶子节点：图元在索引池中的起始位置
+        uint32_t childOffset; //内部节点：第一个非空子节点的位置
+    };
+    uint32_t primitiveCount; //叶子节点图元数量
+    uint8_t childMask; //内部节点非空子节点掩码，第i位对应拐角点i所在的八分体
+    uint8_t isLeaf;
+    OctreeNode() : primitivesOffset(0), primitiveCount(0), childMask(0), isLeaf(0) {}
+};
+
+//8位掩码中1的个数
+inline uint32_t PopCount8(uint32_t x)
+{
+    x = x - ((x >> 1) & 0x55u);
+    x = (x & 0x33u) + ((x >> 2) & 0x33u);
+    return (x + (x >> 4)) & 0x0Fu;
+}
 
 class OctTreeAccel : public Accel
 {
+private:
+    //每条射线缓存最近测试过的图元，避免重复测试跨越多个叶子的图元
+    static constexpr uint32_t kMailboxSize = 16;
+    //遍历栈大小
+    static constexpr int kMaxStackSize = 8 * 64;
 public:
-    OctTreeAccel() : Accel(16, 12) {}
+    explicit OctTreeAccel(int nums = 16, int depth = 12, bool isSparse = true)
+            : Accel(nums, depth), isSparse(isSparse) {}
     ~OctTreeAccel() override = default;
+    virtual void Build() override;
     virtual void Divide(size_t nodeIndex, std::vector<AccelNode> &children) override;
     virtual void Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t> &queue) const override;
-    virtual void StaticCulling() override;
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const override;
+    virtual bool Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const override;
+    virtual bool Occluded(const Ray &ray, float tMax) const override;
+    virtual AccelStats CollectStats() const override;
+private:
+    void BuildNode(uint32_t nodeIndex, const Bounds3f &cell, std::vector<uint32_t> &faces, int depth,
+                   const std::vector<Bounds3f> &faceBounds);
+    //按射线方向符号由近到远遍历，叶子节点交给leafFunc处理
+    template<typename LeafFunc>
+    void TraverseSparse(const Ray &ray, LeafFunc &&leafFunc) const;
+public:
+    //是否使用稀疏八叉树，否则使用通用树的层次构建与遍历
+    bool isSparse;
+    std::vector<OctreeNode> nodes;
+    //叶子图元索引池，叶子节点记录其中的连续范围
+    std::vector<uint32_t> primitiveIndices;
+    //按faceIndices顺序排列的预计算三角形
+    std::vector<PrecomputedTriangle> triangles;
 };
 
+void OctTreeAccel::Build()
+{
+    if (!isSparse)
+    {
+        Accel::Build();
+        return;
+    }
+    std::cout << "[info]: building accel (sparse octree)......" << "\n";
+    std::cout << "[mesh count]:" << meshes.size() << "\n";
+    std::cout << "[triangle count]:" << faceIndices.size() << "\n";
+    nodes.clear();
+    primitiveIndices.clear();
+    triangles.clear();
+    currDepth = 0;
+    leafCount = 0;
+    if (faceIndices.empty())
+    {
+        return;
+    }
+    //预计算三角形与图元包围盒
+    auto count = static_cast<uint32_t>(faceIndices.size());
+    std::vector<Bounds3f> faceBounds(count);
+    triangles.resize(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        auto [meshIndex, faceIndex] = faceIndices[i];
+        const auto &mesh = meshes[meshIndex];
+        auto [idx0, idx1, idx2] = mesh->GetTriangleIndices(faceIndex);
+        triangles[i] = PrecomputedTriangle(mesh->positions[idx0], mesh->positions[idx1], mesh->positions[idx2],
+                                           static_cast<uint32_t>(meshIndex), static_cast<uint32_t>(faceIndex));
+        faceBounds[i] = mesh->GetFaceBounds(faceIndex);
+    }
+    std::vector<uint32_t> faces(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        faces[i] = i;
+    }
+    nodes.emplace_back();
+    BuildNode(0, bounds, faces, 0, faceBounds);
+    //统计数据
+    nodeCount = static_cast<int>(nodes.size());
+    std::cout << "[tree depth]: " << currDepth << std::endl;
+    std::cout << "[node count]: " << nodeCount << std::endl;
+    std::cout << "[leaf count]: " << leafCount << std::endl;
+    std::cout << "[primitive references]: " << primitiveIndices.size() << std::endl;
+}
+void OctTreeAccel::BuildNode(uint32_t nodeIndex, const Bounds3f &cell, std::vector<uint32_t> &faces, int depth,
+                             const std::vector<Bounds3f> &faceBounds)
+{
+    currDepth = std::max(currDepth, depth + 1);
+    //节点包围盒收缩到图元范围
+    Bounds3f faceUnion;
+    for (auto f: faces)
+    {
+        faceUnion.Expand(faceBounds[f]);
+    }
+    nodes[nodeIndex].bounds = ::Intersect(faceUnion, cell);
+    auto makeLeaf = [&]() {
+        auto &node = nodes[nodeIndex];
+        node.isLeaf = 1;
+        node.primitivesOffset = static_cast<uint32_t>(primitiveIndices.size());
+        node.primitiveCount = static_cast<uint32_t>(faces.size());
+        primitiveIndices.insert(primitiveIndices.end(), faces.begin(), faces.end());
+        ++leafCount;
+    };
+    if (faces.size() <= static_cast<size_t>(minNumFaces) || depth >= maxDepth)
+    {
+        makeLeaf();
+        return;
+    }
+    //按八分体分配图元，跨越多个八分体的图元只记录索引
+    Point3f center = cell.Centroid();
+    Bounds3f childCells[8];
+    std::vector<uint32_t> childFaces[8];
+    for (int corner = 0; corner < 8; corner++)
+    {
+        childCells[corner] = Bounds3f(center, cell.Corner(corner));
+    }
+    for (auto f: faces)
+    {
+        for (int corner = 0; corner < 8; corner++)
+        {
+            if (Overlaps(childCells[corner], faceBounds[f]))
+            {
+                childFaces[corner].push_back(f);
+            }
+        }
+    }
+    //图元都跨越多个子节点时继续划分没有意义
+    int nonEmpty = 0;
+    bool isSplit = false;
+    for (const auto &child: childFaces)
+    {
+        nonEmpty += !child.empty();
+        isSplit |= !child.empty() && child.size() < faces.size();
+    }
+    if (nonEmpty > 1 && !isSplit)
+    {
+        makeLeaf();
+        return;
+    }
+    faces.clear();
+    faces.shrink_to_fit();
+    //只为非空八分体分配子节点
+    auto childOffset = static_cast<uint32_t>(nodes.size());
+    uint8_t childMask = 0;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        if (!childFaces[corner].empty())
+        {
+            childMask |= static_cast<uint8_t>(1u << corner);
+        }
+    }
+    nodes.resize(nodes.size() + nonEmpty);
+    nodes[nodeIndex].childOffset = childOffset;
+    nodes[nodeIndex].childMask = childMask;
+    uint32_t child = childOffset;
+    for (int corner = 0; corner < 8; corner++)
+    {
+        if (!childFaces[corner].empty())
+        {
+            BuildNode(child++, childCells[corner], childFaces[corner], depth + 1, faceBounds);
+        }
+    }
+}
 void OctTreeAccel::Divide(size_t nodeIndex, std::vector<AccelNode> &children)
 {
     auto &node = tree[nodeIndex];
@@ -66,6 +243,186 @@ void OctTreeAccel::Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t>
         queue.push(i);
     }
 }
-void OctTreeAccel::StaticCulling()
+void OctTreeAccel::StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
+{
+    if (!isSparse || nodes.empty())
+    {
+        CullTreeLeaves(frustum, visibleFaces);
+        return;
+    }
+    //图元可能跨越多个叶子，标记已输出的图元
+    std::vector<uint8_t> isEmitted(faceIndices.size(), 0);
+    std::pair<uint32_t, uint32_t> stack[kMaxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = {0, Frustum::kAllPlanes};
+    while (stackSize > 0)
+    {
+        auto [current, planeMask] = stack[--stackSize];
+        const auto &node = nodes[current];
+        if (planeMask != 0 && !frustum.Intersect(node.bounds, planeMask))
+        {
+            continue;
+        }
+        if (node.isLeaf)
+        {
+            for (uint32_t i = 0; i < node.primitiveCount; ++i)
+            {
+                uint32_t f = primitiveIndices[node.primitivesOffset + i];
+                if (!isEmitted[f])
+                {
+                    isEmitted[f] = 1;
+                    visibleFaces.push_back(faceIndices[f]);
+                }
+            }
+            continue;
+        }
+        for (uint32_t c = 0; c < PopCount8(node.childMask); ++c)
+        {
+            stack[stackSize++] = {node.childOffset + c, planeMask};
+        }
+    }
+}
+template<typename LeafFunc>
+void OctTreeAccel::TraverseSparse(const Ray &ray, LeafFunc &&leafFunc) const
 {
+    Vector3f invDir = 1.0f / ray.direction;
+    //方向为负的维度先访问上半部分，按序号与翻转位异或即为由近到远的顺序
+    uint32_t flip = (ray.direction.x < 0 ? 1u : 0u) | (ray.direction.y < 0 ? 2u : 0u) |
+                    (ray.direction.z < 0 ? 4u : 0u);
+    uint32_t stack[kMaxStackSize];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while (stackSize > 0)
+    {
+        const auto &node = nodes[stack[--stackSize]];
+        ACCEL_STATS_ADD(nodeVisits, 1);
+        if (!node.bounds.RayIntersect(ray, invDir))
+        {
+            continue;
+        }
+        if (node.isLeaf)
+        {
+            //叶子节点返回true时终止遍历
+            if (leafFunc(node)) break;
+            continue;
+        }
+        //由远到近入栈，近处子节点先出栈
+        for (int i = 7; i >= 0; --i)
+        {
+            uint32_t corner = static_cast<uint32_t>(i) ^ flip;
+            if (node.childMask & (1u << corner))
+            {
+                stack[stackSize++] = node.childOffset + PopCount8(node.childMask & ((1u << corner) - 1));
+            }
+        }
+    }
 }
+bool OctTreeAccel::Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const
+{
+    if (!isSparse || nodes.empty())
+    {
+        return Accel::Intersect(ray, record, hitFace, isShadow);
+    }
+    uint32_t mailbox[kMailboxSize];
+    std::fill(mailbox, mailbox + kMailboxSize, std::numeric_limits<uint32_t>::max());
+    size_t hitMesh = 0;
+    bool isHit = false;
+    TraverseSparse(ray, [&](const OctreeNode &node) {
+        for (uint32_t i = 0; i < node.primitiveCount; ++i)
+        {
+            uint32_t f = primitiveIndices[node.primitivesOffset + i];
+            //已测试过的图元跳过，射线的tMax只会减小，重复测试结果不变
+            auto &slot = mailbox[f & (kMailboxSize - 1)];
+            if (slot == f)
+            {
+                continue;
+            }
+            slot = f;
+            ACCEL_STATS_ADD(triangleTests, 1);
+            const auto &triangle = triangles[f];
+            if (triangle.RayIntersect(ray, record))
+            {
+                hitMesh = triangle.meshIndex;
+                hitFace = triangle.faceIndex;
+                isHit = true;
+                //阴影测试击中直接返回
+                if (isShadow)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    });
+    if (isHit && !isShadow)
+    {
+        record.hitMesh = meshes[hitMesh];
+    }
+    return isHit;
+}
+bool OctTreeAccel::Occluded(const Ray &ray, float tMax) const
+{
+    if (!isSparse || nodes.empty())
+    {
+        return Accel::Occluded(ray, tMax);
+    }
+    Ray shadowRay = ray;
+    shadowRay.tMax = std::min(ray.tMax, tMax);
+    uint32_t mailbox[kMailboxSize];
+    std::fill(mailbox, mailbox + kMailboxSize, std::numeric_limits<uint32_t>::max());
+    bool isOccluded = false;
+    TraverseSparse(shadowRay, [&](const OctreeNode &node) {
+        for (uint32_t i = 0; i < node.primitiveCount; ++i)
+        {
+            uint32_t f = primitiveIndices[node.primitivesOffset + i];
+            auto &slot = mailbox[f & (kMailboxSize - 1)];
+            if (slot == f)
+            {
+                continue;
+            }
+            slot = f;
+            ACCEL_STATS_ADD(triangleTests, 1);
+            if (triangles[f].Occluded(shadowRay))
+            {
+                isOccluded = true;
+                return true;
+            }
+        }
+        return false;
+    });
+    return isOccluded;
+}
+AccelStats OctTreeAccel::CollectStats() const
+{
+    if (!isSparse || nodes.empty())
+    {
+        return Accel::CollectStats();
+    }
+    AccelStats stats;
+    stats.type = ReadableTypeName(typeid(*this));
+    stats.nodeCount = static_cast<int>(nodes.size());
+    stats.leafCount = leafCount;
+    stats.maxDepth = currDepth;
+    //子节点总在父节点之后，正序遍历即可得到深度；成本模型与BVH相同
+    constexpr float kTraversalCost = 0.125f;
+    std::vector<int> depths(nodes.size(), 0);
+    float cost = 0.0f;
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const auto &node = nodes[i];
+        if (node.isLeaf)
+        {
+            stats.AddLeaf(node.primitiveCount, depths[i]);
+            cost += static_cast<float>(node.primitiveCount) * node.bounds.SurfaceArea();
+            continue;
+        }
+        cost += kTraversalCost * node.bounds.SurfaceArea();
+        for (uint32_t c = 0; c < PopCount8(node.childMask); ++c)
+        {
+            depths[node.childOffset + c] = depths[i] + 1;
+        }
+    }
+    float rootArea = nodes[0].bounds.SurfaceArea();
+    stats.sahCost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+    return stats;
+}
\ No newline at end of file
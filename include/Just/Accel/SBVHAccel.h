@@ -0,0 +1,457 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Accel/BVHAccel.h"
+
+//图元引用，空间划分后同一图元可以被多个叶子引用，包围盒为裁剪后的部分
+struct SBVHReference
+{
+    Bounds3f bounds;
+    uint32_t primitive;
+};
+
+//空间划分分箱
+struct SBVHSpatialBin
+{
+    Bounds3f bounds;
+    uint32_t entry = 0; //从该分箱进入的引用数量
+    uint32_t exit = 0; //从该分箱离开的引用数量
+};
+
+//空间划分BVH，对象划分之外尝试按平面裁剪三角形，适合包含大面积三角形的建筑场景
+struct SBVHAccel : public BVHAccel
+{
+private:
+    //空间划分分箱数量
+    static constexpr int kNumSpatialBins = 16;
+    //对象划分子节点重叠面积与场景表面积之比超过该值时才尝试空间划分
+    static constexpr float kSplitAlpha = 1e-5f;
+public:
+    explicit SBVHAccel(int nums = 16, int depth = 32, float budget = 0.3f)
+            : BVHAccel(nums, depth), splitBudget(budget) {}
+    ~SBVHAccel() override = default;
+    virtual void Build() override;
+    //空间划分的图元可能出现在多个叶子中，剔除结果去重
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const override;
+    //同一图元只在第一次出现的叶子中交给visitLeaf，避免重复光栅化与着色
+    virtual void OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                                  const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const override;
+    virtual uint64_t ContentHash() const override;
+private:
+    uint32_t BuildNode(std::vector<SBVHReference> &refs, int depth,
+                       std::vector<std::pair<size_t, size_t>> &orderedFaces);
+    //三角形在[lo, hi]平面区间内部分的包围盒，并限制在引用包围盒内
+    Bounds3f ClipTriangle(uint32_t primitive, int axis, float lo, float hi, const Bounds3f &refBounds) const;
+public:
+    //空间划分允许增加的引用数量，相对三角形数量的比例
+    float splitBudget;
+    //构建统计
+    size_t referenceCount = 0;
+    size_t spatialSplitCount = 0;
+private:
+    //构建时的三角形顶点
+    std::vector<Point3f> vertices;
+    size_t referenceLimit = 0;
+    float rootArea = 0.0f;
+};
+
+void SBVHAccel::Build()
+{
+    std::cout << "[info]: building accel (SBVH)......" << "\n";
+    std::cout << "[mesh count]:" << meshes.size() << "\n";
+    linearTree.clear();
+    //重新构建时去掉上次空间划分产生的重复引用
+    std::sort(faceIndices.begin(), faceIndices.end());
+    faceIndices.erase(std::unique(faceIndices.begin(), faceIndices.end()), faceIndices.end());
+    std::cout << "[triangle count]:" << faceIndices.size() << "\n";
+    if (faceIndices.empty())
+    {
+        return;
+    }
+    auto count = static_cast<uint32_t>(faceIndices.size());
+    vertices.resize(3 * static_cast<size_t>(count));
+    std::vector<SBVHReference> refs(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        auto [meshIndex, faceIndex] = faceIndices[i];
+        const auto &mesh = meshes[meshIndex];
+        auto [idx0, idx1, idx2] = mesh->GetTriangleIndices(faceIndex);
+        vertices[3 * i + 0] = mesh->positions[idx0];
+        vertices[3 * i + 1] = mesh->positions[idx1];
+        vertices[3 * i + 2] = mesh->positions[idx2];
+        refs[i].bounds = mesh->GetFaceBounds(faceIndex);
+        refs[i].primitive = static_cast<uint32_t>(i);
+    }
+    referenceCount = count;
+    referenceLimit = count + static_cast<size_t>(static_cast<float>(count) * std::max(splitBudget, 0.0f));
+    spatialSplitCount = 0;
+    Bounds3f rootBounds;
+    for (const auto &ref: refs)
+    {
+        rootBounds.Expand(ref.bounds);
+    }
+    rootArea = rootBounds.SurfaceArea();
+    //叶子按深度优先顺序写入，空间划分的图元在faceIndices中重复出现
+    std::vector<std::pair<size_t, size_t>> orderedFaces;
+    orderedFaces.reserve(referenceLimit);
+    linearTree.reserve(2 * referenceLimit / std::max(minNumFaces, 1) + 1);
+    BuildNode(refs, 0, orderedFaces);
+    faceIndices.swap(orderedFaces);
+    vertices.clear();
+    vertices.shrink_to_fit();
+    FinishLinearBuild();
+    //统计数据
+    CountLinearTree();
+    std::cout << "[tree depth]: " << currDepth << std::endl;
+    std::cout << "[node count]: " << nodeCount << std::endl;
+    std::cout << "[leaf count]: " << leafCount << std::endl;
+    std::cout << "[reference count]: " << faceIndices.size() << std::endl;
+    std::cout << "[spatial split count]: " << spatialSplitCount << std::endl;
+}
+void SBVHAccel::StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
+{
+    auto begin = visibleFaces.size();
+    BVHAccel::StaticCulling(frustum, visibleFaces);
+    std::sort(visibleFaces.begin() + begin, visibleFaces.end());
+    visibleFaces.erase(std::unique(visibleFaces.begin() + begin, visibleFaces.end()), visibleFaces.end());
+}
+void SBVHAccel::OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                                 const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const
+{
+    //每个网格的面在访问标记中的起始位置
+    std::vector<size_t> faceOffsets(meshes.size() + 1, 0);
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        faceOffsets[i + 1] = faceOffsets[i] + meshes[i]->GetTriangleCount();
+    }
+    std::vector<bool> isVisited(faceOffsets.back(), false);
+    std::vector<std::pair<size_t, size_t>> leafFaces;
+    BVHAccel::OcclusionCulling(frustum, isOccluded, [&](const std::pair<size_t, size_t> *faces, size_t count) {
+        leafFaces.clear();
+        for (size_t i = 0; i < count; ++i)
+        {
+            size_t index = faceOffsets[faces[i].first] + faces[i].second;
+            if (!isVisited[index])
+            {
+                isVisited[index] = true;
+                leafFaces.push_back(faces[i]);
+            }
+        }
+        if (!leafFaces.empty())
+        {
+            visitLeaf(leafFaces.data(), leafFaces.size());
+        }
+    });
+}
+uint64_t SBVHAccel::ContentHash() const
+{
+    //引用预算影响划分结果
+    return HashValue(splitBudget, BVHAccel::ContentHash());
+}
+Bounds3f SBVHAccel::ClipTriangle(uint32_t primitive, int axis, float lo, float hi, const Bounds3f &refBounds) const
+{
+    //保留区间内的顶点与各边和两个平面的交点
+    Bounds3f clipped;
+    const Point3f *v = &vertices[3 * static_cast<size_t>(primitive)];
+    for (int i = 0; i < 3; ++i)
+    {
+        const Point3f &a = v[i];
+        const Point3f &b = v[(i + 1) % 3];
+        float ta = a[axis], tb = b[axis];
+        if (ta >= lo && ta <= hi)
+        {
+            clipped.Expand(a);
+        }
+        for (float plane: {lo, hi})
+        {
+            if ((ta < plane && tb > plane) || (ta > plane && tb < plane))
+            {
+                Point3f p = a + (b - a) * ((plane - ta) / (tb - ta));
+                p[axis] = plane;
+                clipped.Expand(p);
+            }
+        }
+    }
+    //引用包围盒可能已经被上层裁剪过
+    Bounds3f ret;
+    ret.pMin = Max(clipped.pMin, refBounds.pMin);
+    ret.pMax = Min(clipped.pMax, refBounds.pMax);
+    for (int d = 0; d < 3; ++d)
+    {
+        if (ret.pMin[d] > ret.pMax[d])
+        {
+            return {};
+        }
+    }
+    return ret;
+}
+uint32_t SBVHAccel::BuildNode(std::vector<SBVHReference> &refs, int depth,
+                              std::vector<std::pair<size_t, size_t>> &orderedFaces)
+{
+    auto offset = static_cast<uint32_t>(linearTree.size());
+    linearTree.emplace_back();
+    Bounds3f nodeBounds, centroidBounds;
+    for (const auto &ref: refs)
+    {
+        nodeBounds.Expand(ref.bounds);
+        centroidBounds.Expand(ref.bounds.Centroid());
+    }
+    linearTree[offset].bounds = nodeBounds;
+    auto count = static_cast<uint32_t>(refs.size());
+    bool canBeLeaf = count <= maxLeafSize;
+    if (canBeLeaf && (count <= static_cast<uint32_t>(minNumFaces) || depth >= maxDepth))
+    {
+        linearTree[offset].isLeaf = 1;
+        linearTree[offset].primitivesOffset = static_cast<uint32_t>(orderedFaces.size());
+        linearTree[offset].primitiveCount = static_cast<uint16_t>(count);
+        for (const auto &ref: refs)
+        {
+            orderedFaces.push_back(faceIndices[ref.primitive]);
+        }
+        return offset;
+    }
+    float invSA = 1.0f / nodeBounds.SurfaceArea();
+
+    //对象划分：按质心分箱
+    Vector3f extent = centroidBounds.Diagonal();
+    float objectCost = std::numeric_limits<float>::infinity();
+    int objectAxis = -1;
+    int objectSplit = 0;
+    Bounds3f objectLeft, objectRight;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (extent[axis] <= 0.0f)
+        {
+            continue;
+        }
+        BVHBin bins[kNumBins];
+        float scale = static_cast<float>(kNumBins) / extent[axis];
+        for (const auto &ref: refs)
+        {
+            int b = std::min(kNumBins - 1,
+                             static_cast<int>((ref.bounds.Centroid()[axis] - centroidBounds.pMin[axis]) * scale));
+            bins[b].count++;
+            bins[b].bounds.Expand(ref.bounds);
+        }
+        Bounds3f rightBounds[kNumBins];
+        uint32_t rightCount[kNumBins];
+        Bounds3f accumulated;
+        uint32_t rightSum = 0;
+        for (int b = kNumBins - 1; b > 0; --b)
+        {
+            accumulated.Expand(bins[b].bounds);
+            rightSum += bins[b].count;
+            rightBounds[b] = accumulated;
+            rightCount[b] = rightSum;
+        }
+        Bounds3f leftBounds;
+        uint32_t leftSum = 0;
+        for (int b = 1; b < kNumBins; ++b)
+        {
+            leftBounds.Expand(bins[b - 1].bounds);
+            leftSum += bins[b - 1].count;
+            if (leftSum == 0 || rightCount[b] == 0)
+            {
+                continue;
+            }
+            float cost = kTraversalCost +
+                         (static_cast<float>(leftSum) * leftBounds.SurfaceArea() +
+                          static_cast<float>(rightCount[b]) * rightBounds[b].SurfaceArea()) * invSA;
+            if (cost < objectCost)
+            {
+                objectCost = cost;
+                objectAxis = axis;
+                objectSplit = b;
+                objectLeft = leftBounds;
+                objectRight = rightBounds[b];
+            }
+        }
+    }
+
+    //空间划分：对象划分的子节点重叠较大且未超出引用预算时尝试
+    float spatialCost = std::numeric_limits<float>::infinity();
+    int spatialAxis = -1;
+    float spatialPosition = 0.0f;
+    bool trySpatial = referenceCount < referenceLimit;
+    if (trySpatial && objectAxis >= 0 && Overlaps(objectLeft, objectRight))
+    {
+        trySpatial = ::Intersect(objectLeft, objectRight).SurfaceArea() > kSplitAlpha * rootArea;
+    }
+    if (trySpatial)
+    {
+        Vector3f nodeExtent = nodeBounds.Diagonal();
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            if (nodeExtent[axis] <= 0.0f)
+            {
+                continue;
+            }
+            SBVHSpatialBin bins[kNumSpatialBins];
+            float origin = nodeBounds.pMin[axis];
+            float width = nodeExtent[axis] / static_cast<float>(kNumSpatialBins);
+            float invWidth = 1.0f / width;
+            for (const auto &ref: refs)
+            {
+                int first = std::clamp(static_cast<int>((ref.bounds.pMin[axis] - origin) * invWidth),
+                                       0, kNumSpatialBins - 1);
+                int last = std::clamp(static_cast<int>((ref.bounds.pMax[axis] - origin) * invWidth),
+                                      first, kNumSpatialBins - 1);
+                //引用跨越的每个分箱只加入裁剪后的部分
+                for (int b = first; b <= last; ++b)
+                {
+                    float lo = origin + width * static_cast<float>(b);
+                    float hi = b == kNumSpatialBins - 1 ? nodeBounds.pMax[axis] : lo + width;
+                    bins[b].bounds.Expand(first == last ? ref.bounds : ClipTriangle(ref.primitive, axis, lo, hi,
+                                                                                    ref.bounds));
+                }
+                bins[first].entry++;
+                bins[last].exit++;
+            }
+            Bounds3f rightBounds[kNumSpatialBins];
+            uint32_t rightCount[kNumSpatialBins];
+            Bounds3f accumulated;
+            uint32_t rightSum = 0;
+            for (int b = kNumSpatialBins - 1; b > 0; --b)
+            {
+                accumulated.Expand(bins[b].bounds);
+                rightSum += bins[b].exit;
+                rightBounds[b] = accumulated;
+                rightCount[b] = rightSum;
+            }
+            Bounds3f leftBounds;
+            uint32_t leftSum = 0;
+            for (int b = 1; b < kNumSpatialBins; ++b)
+            {
+                leftBounds.Expand(bins[b - 1].bounds);
+                leftSum += bins[b - 1].entry;
+                if (leftSum == 0 || rightCount[b] == 0)
+                {
+                    continue;
+                }
+                //跨越划分平面的引用会被复制，超出预算时跳过
+                if (referenceCount + leftSum + rightCount[b] - count > referenceLimit)
+                {
+                    continue;
+                }
+                float cost = kTraversalCost +
+                             (static_cast<float>(leftSum) * leftBounds.SurfaceArea() +
+                              static_cast<float>(rightCount[b]) * rightBounds[b].SurfaceArea()) * invSA;
+                if (cost < spatialCost)
+                {
+                    spatialCost = cost;
+                    spatialAxis = axis;
+                    spatialPosition = origin + width * static_cast<float>(b);
+                }
+            }
+        }
+    }
+
+    //划分引用
+    std::vector<SBVHReference> left, right;
+    int splitAxis = objectAxis;
+    if (spatialAxis >= 0 && spatialCost < objectCost)
+    {
+        splitAxis = spatialAxis;
+        //先放入完全位于两侧的引用，跨越平面的三角形裁剪为两部分
+        float inf = std::numeric_limits<float>::infinity();
+        std::vector<SBVHReference> straddlers[2];
+        Bounds3f sideBounds[2];
+        for (const auto &ref: refs)
+        {
+            if (ref.bounds.pMax[spatialAxis] <= spatialPosition)
+            {
+                left.push_back(ref);
+                sideBounds[0].Expand(ref.bounds);
+            }
+            else if (ref.bounds.pMin[spatialAxis] >= spatialPosition)
+            {
+                right.push_back(ref);
+                sideBounds[1].Expand(ref.bounds);
+            }
+            else
+            {
+                Bounds3f leftBounds = ClipTriangle(ref.primitive, spatialAxis, -inf, spatialPosition, ref.bounds);
+                Bounds3f rightBounds = ClipTriangle(ref.primitive, spatialAxis, spatialPosition, inf, ref.bounds);
+                //只接触划分平面的三角形裁剪后一侧为空
+                if (leftBounds.pMin.x > leftBounds.pMax.x || rightBounds.pMin.x > rightBounds.pMax.x)
+                {
+                    bool isLeft = leftBounds.pMin.x <= leftBounds.pMax.x;
+                    (isLeft ? left : right).push_back(ref);
+                    sideBounds[isLeft ? 0 : 1].Expand(ref.bounds);
+                    continue;
+                }
+                sideBounds[0].Expand(leftBounds);
+                sideBounds[1].Expand(rightBounds);
+                straddlers[0].push_back({leftBounds, ref.primitive});
+                straddlers[1].push_back({rightBounds, ref.primitive});
+            }
+        }
+        //引用反划分：整个三角形放入一侧的SAH更低时不复制
+        auto leftCount = static_cast<float>(left.size() + straddlers[0].size());
+        auto rightCount = static_cast<float>(right.size() + straddlers[1].size());
+        for (size_t i = 0; i < straddlers[0].size(); ++i)
+        {
+            uint32_t primitive = straddlers[0][i].primitive;
+            Bounds3f whole = straddlers[0][i].bounds;
+            whole.Expand(straddlers[1][i].bounds);
+            Bounds3f leftUnion = sideBounds[0], rightUnion = sideBounds[1];
+            leftUnion.Expand(whole);
+            rightUnion.Expand(whole);
+            float splitCost = sideBounds[0].SurfaceArea() * leftCount + sideBounds[1].SurfaceArea() * rightCount;
+            float leftCost = leftUnion.SurfaceArea() * leftCount + sideBounds[1].SurfaceArea() * (rightCount - 1);
+            float rightCost = sideBounds[0].SurfaceArea() * (leftCount - 1) + rightUnion.SurfaceArea() * rightCount;
+            if (splitCost <= leftCost && splitCost <= rightCost)
+            {
+                left.push_back(straddlers[0][i]);
+                right.push_back(straddlers[1][i]);
+                ++referenceCount;
+            }
+            else if (leftCost <= rightCost)
+            {
+                left.push_back({whole, primitive});
+                sideBounds[0] = leftUnion;
+                rightCount -= 1;
+            }
+            else
+            {
+                right.push_back({whole, primitive});
+                sideBounds[1] = rightUnion;
+                leftCount -= 1;
+            }
+        }
+        ++spatialSplitCount;
+    }
+    else if (objectAxis >= 0)
+    {
+        float pMin = centroidBounds.pMin[objectAxis];
+        float scale = static_cast<float>(kNumBins) / extent[objectAxis];
+        for (const auto &ref: refs)
+        {
+            int b = std::min(kNumBins - 1, static_cast<int>((ref.bounds.Centroid()[objectAxis] - pMin) * scale));
+            (b < objectSplit ? left : right).push_back(ref);
+        }
+    }
+    //无有效划分时按最长维度中位数划分
+    if (left.empty() || right.empty())
+    {
+        splitAxis = static_cast<int>(centroidBounds.MajorAxis());
+        auto mid = refs.begin() + count / 2;
+        std::nth_element(refs.begin(), mid, refs.end(), [splitAxis](const SBVHReference &l, const SBVHReference &r) {
+            return l.bounds.Centroid()[splitAxis] < r.bounds.Centroid()[splitAxis];
+        });
+        left.assign(refs.begin(), mid);
+        right.assign(mid, refs.end());
+    }
+    refs.clear();
+    refs.shrink_to_fit();
+
+    //第一个子节点紧跟父节点
+    linearTree[offset].axis = static_cast<uint8_t>(splitAxis);
+    BuildNode(left, depth + 1, orderedFaces);
+    auto secondChild = BuildNode(right, depth + 1, orderedFaces);
+    linearTree[offset].secondChildOffset = secondChild;
+    return offset;
+}
\ No newline at end of file
@@ -0,0 +1,362 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Accel/BVHAccel.h"
+
+//8叉BVH节点，子节点包围盒按分量分别存放，一次SIMD测试即可完成全部子节点的求交
+struct alignas(32) WideBVHNode
+{
+    static constexpr int kWidth = 8;
+    float minX[kWidth], minY[kWidth], minZ[kWidth];
+    float maxX[kWidth], maxY[kWidth], maxZ[kWidth];
+    //叶子子节点：图元起始位置；内部子节点：节点位置
+    uint32_t children[kWidth];
+    //叶子子节点的图元数量，内部子节点为0
+    uint16_t primitiveCounts[kWidth];
+    uint8_t childCount;
+    WideBVHNode() : minX(), minY(), minZ(), maxX(), maxY(), maxZ(), children(), primitiveCounts(), childCount(0) {}
+    //射线与全部子节点求交，返回击中子节点的位掩码，tNear写入各子节点的进入距离
+    uint32_t IntersectChildren(const Point3f &origin, const Vector3f &invDir, float rayTMin, float rayTMax,
+                               float *tNear) const;
+};
+static_assert(sizeof(WideBVHNode) == 256, "WideBVHNode should be 256 bytes");
+
+#if defined(ENABLE_AVX2)
+inline uint32_t WideBVHNode::IntersectChildren(const Point3f &origin, const Vector3f &invDir,
+                                               float rayTMin, float rayTMax, float *tNear) const
+{
+    auto slab = [](const float *pMin, const float *pMax, float o, float inv, __m256 &near, __m256 &far) {
+        __m256 vo = _mm256_set1_ps(o);
+        __m256 vinv = _mm256_set1_ps(inv);
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(pMin), vo), vinv);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(pMax), vo), vinv);
+        near = _mm256_max_ps(_mm256_min_ps(t1, t0), near);
+        far = _mm256_min_ps(_mm256_max_ps(t0, t1), far);
+    };
+    __m256 near = _mm256_set1_ps(rayTMin);
+    __m256 far = _mm256_set1_ps(rayTMax);
+    slab(minX, maxX, origin.x, invDir.x, near, far);
+    slab(minY, maxY, origin.y, invDir.y, near, far);
+    slab(minZ, maxZ, origin.z, invDir.z, near, far);
+    _mm256_storeu_ps(tNear, near);
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(near, far, _CMP_LE_OQ))) &
+           ((1u << childCount) - 1);
+}
+#elif defined(ENABLE_SSE)
+inline uint32_t WideBVHNode::IntersectChildren(const Point3f &origin, const Vector3f &invDir,
+                                               float rayTMin, float rayTMax, float *tNear) const
+{
+    //分两次处理4个子节点
+    uint32_t mask = 0;
+    for (int half = 0; half < childCount; half += 4)
+    {
+        auto slab = [half](const float *pMin, const float *pMax, float o, float inv, __m128 &near, __m128 &far) {
+            __m128 vo = _mm_set1_ps(o);
+            __m128 vinv = _mm_set1_ps(inv);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(pMin + half), vo), vinv);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(pMax + half), vo), vinv);
+            near = _mm_max_ps(_mm_min_ps(t1, t0), near);
+            far = _mm_min_ps(_mm_max_ps(t0, t1), far);
+        };
+        __m128 near = _mm_set1_ps(rayTMin);
+        __m128 far = _mm_set1_ps(rayTMax);
+        slab(minX, maxX, origin.x, invDir.x, near, far);
+        slab(minY, maxY, origin.y, invDir.y, near, far);
+        slab(minZ, maxZ, origin.z, invDir.z, near, far);
+        _mm_storeu_ps(tNear + half, near);
+        mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(near, far))) << half;
+    }
+    return mask & ((1u << childCount) - 1);
+}
+#else
+inline uint32_t WideBVHNode::IntersectChildren(const Point3f &origin, const Vector3f &invDir,
+                                               float rayTMin, float rayTMax, float *tNear) const
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < childCount; ++i)
+    {
+        Bounds3f bounds(Point3f(minX[i], minY[i], minZ[i]), Point3f(maxX[i], maxY[i], maxZ[i]));
+        float near = rayTMin, far = rayTMax;
+        for (int axis = 0; axis < 3; ++axis)
+        {
+            float t0 = (bounds.pMin[axis] - origin[axis]) * invDir[axis];
+            float t1 = (bounds.pMax[axis] - origin[axis]) * invDir[axis];
+            if (t0 > t1) std::swap(t0, t1);
+            near = t0 > near ? t0 : near;
+            far = t1 < far ? t1 : far;
+        }
+        tNear[i] = near;
+        mask |= static_cast<uint32_t>(near <= far) << i;
+    }
+    return mask;
+}
+#endif
+
+//宽BVH：先构建二叉BVH，再把每个节点的后代展开合并为最多8个子节点
+struct WideBVHAccel : public BVHAccel
+{
+public:
+    explicit WideBVHAccel(int nums = 4, int depth = 32) : BVHAccel(nums, depth) {}
+    ~WideBVHAccel() override = default;
+    virtual void Build() override;
+    virtual void Refit(size_t meshIndex) override;
+    virtual bool Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const override;
+    virtual bool Occluded(const Ray &ray, float tMax) const override;
+    virtual bool LoadCache(const std::string &path) override;
+    //统计宽树结构，叶子为宽节点中的叶子子节点
+    virtual AccelStats CollectStats() const override;
+private:
+    //二叉树节点合并为宽节点，返回宽节点位置
+    uint32_t Collapse(uint32_t binaryIndex);
+    void CollapseTree();
+public:
+    std::vector<WideBVHNode> wideTree;
+};
+
+void WideBVHAccel::Build()
+{
+    BVHAccel::Build();
+    CollapseTree();
+}
+void WideBVHAccel::Refit(size_t meshIndex)
+{
+    //更新二叉树后重新合并，合并只与节点数量相关，开销很小
+    BVHAccel::Refit(meshIndex);
+    CollapseTree();
+}
+bool WideBVHAccel::LoadCache(const std::string &path)
+{
+    //缓存中保存二叉树，读取后重新合并
+    if (!BVHAccel::LoadCache(path))
+    {
+        return false;
+    }
+    CollapseTree();
+    return true;
+}
+void WideBVHAccel::CollapseTree()
+{
+    wideTree.clear();
+    if (linearTree.empty())
+    {
+        return;
+    }
+    wideTree.reserve(linearTree.size() / 4 + 1);
+    //根节点为叶子时，宽树根节点只有一个叶子子节点
+    if (linearTree[0].isLeaf)
+    {
+        auto &root = wideTree.emplace_back();
+        const auto &leaf = linearTree[0];
+        root.childCount = 1;
+        root.minX[0] = leaf.bounds.pMin.x, root.minY[0] = leaf.bounds.pMin.y, root.minZ[0] = leaf.bounds.pMin.z;
+        root.maxX[0] = leaf.bounds.pMax.x, root.maxY[0] = leaf.bounds.pMax.y, root.maxZ[0] = leaf.bounds.pMax.z;
+        root.children[0] = leaf.primitivesOffset;
+        root.primitiveCounts[0] = leaf.primitiveCount;
+    }
+    else
+    {
+        Collapse(0);
+    }
+    std::cout << "[wide node count]: " << wideTree.size() << std::endl;
+}
+AccelStats WideBVHAccel::CollectStats() const
+{
+    if (wideTree.empty())
+    {
+        return BVHAccel::CollectStats();
+    }
+    AccelStats stats;
+    stats.type = ReadableTypeName(typeid(*this));
+    stats.nodeCount = static_cast<int>(wideTree.size());
+    //合并时父节点先于子节点写入，正序遍历即可得到深度
+    std::vector<int> depths(wideTree.size(), 0);
+    float cost = 0.0f, rootArea = 0.0f;
+    for (size_t i = 0; i < wideTree.size(); ++i)
+    {
+        const auto &node = wideTree[i];
+        Bounds3f nodeBounds;
+        for (int c = 0; c < node.childCount; ++c)
+        {
+            Bounds3f childBounds(Point3f(node.minX[c], node.minY[c], node.minZ[c]),
+                                 Point3f(node.maxX[c], node.maxY[c], node.maxZ[c]));
+            nodeBounds.Expand(childBounds);
+            if (node.primitiveCounts[c] > 0)
+            {
+                ++stats.leafCount;
+                stats.maxDepth = std::max(stats.maxDepth, depths[i] + 2);
+                stats.AddLeaf(node.primitiveCounts[c], depths[i] + 1);
+                cost += static_cast<float>(node.primitiveCounts[c]) * childBounds.SurfaceArea();
+            }
+            else
+            {
+                depths[node.children[c]] = depths[i] + 1;
+            }
+        }
+        cost += kTraversalCost * nodeBounds.SurfaceArea();
+        rootArea = i == 0 ? nodeBounds.SurfaceArea() : rootArea;
+    }
+    stats.sahCost = rootArea > 0.0f ? cost / rootArea : 0.0f;
+    return stats;
+}
+uint32_t WideBVHAccel::Collapse(uint32_t binaryIndex)
+{
+    auto wideIndex = static_cast<uint32_t>(wideTree.size());
+    wideTree.emplace_back();
+    //反复展开表面积最大的内部子节点，直到子节点数量达到宽度
+    uint32_t children[WideBVHNode::kWidth];
+    int childCount = 2;
+    children[0] = binaryIndex + 1;
+    children[1] = linearTree[binaryIndex].secondChildOffset;
+    while (childCount < WideBVHNode::kWidth)
+    {
+        int best = -1;
+        float bestArea = -1.0f;
+        for (int i = 0; i < childCount; ++i)
+        {
+            const auto &child = linearTree[children[i]];
+            if (!child.isLeaf && child.bounds.SurfaceArea() > bestArea)
+            {
+                best = i;
+                bestArea = child.bounds.SurfaceArea();
+            }
+        }
+        if (best < 0)
+        {
+            break;
+        }
+        uint32_t expanded = children[best];
+        children[best] = expanded + 1;
+        children[childCount++] = linearTree[expanded].secondChildOffset;
+    }
+    //写入子节点，内部子节点递归合并，跳过空叶子
+    int count = 0;
+    for (int i = 0; i < childCount; ++i)
+    {
+        const auto &child = linearTree[children[i]];
+        if (child.isLeaf && child.primitiveCount == 0)
+        {
+            continue;
+        }
+        uint32_t target = child.isLeaf ? child.primitivesOffset : Collapse(children[i]);
+        auto &node = wideTree[wideIndex];
+        node.minX[count] = child.bounds.pMin.x, node.minY[count] = child.bounds.pMin.y;
+        node.minZ[count] = child.bounds.pMin.z;
+        node.maxX[count] = child.bounds.pMax.x, node.maxY[count] = child.bounds.pMax.y;
+        node.maxZ[count] = child.bounds.pMax.z;
+        node.children[count] = target;
+        node.primitiveCounts[count] = child.isLeaf ? child.primitiveCount : 0;
+        ++count;
+    }
+    wideTree[wideIndex].childCount = static_cast<uint8_t>(count);
+    return wideIndex;
+}
+bool WideBVHAccel::Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const
+{
+    if (wideTree.empty())
+    {
+        return BVHAccel::Intersect(ray, record, hitFace, isShadow);
+    }
+    //栈中保存子节点及其进入距离，出栈时距离超过当前最近交点则跳过
+    struct StackEntry
+    {
+        uint32_t index;
+        uint16_t primitiveCount;
+        float tNear;
+    };
+    StackEntry stack[kMaxStackSize * WideBVHNode::kWidth];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0, ray.tMin};
+    Vector3f invDir = 1.0f / ray.direction;
+    size_t hitMesh = 0;
+    bool isHit = false;
+    while (stackSize > 0)
+    {
+        auto entry = stack[--stackSize];
+        if (entry.tNear > ray.tMax)
+        {
+            continue;
+        }
+        //叶子子节点直接求交
+        if (entry.primitiveCount > 0)
+        {
+            if (IntersectLeaf(entry.index, entry.primitiveCount, ray, record, hitMesh, hitFace, isShadow))
+            {
+                isHit = true;
+                if (isShadow)
+                {
+                    return true;
+                }
+            }
+            continue;
+        }
+        const auto &node = wideTree[entry.index];
+        ACCEL_STATS_ADD(nodeVisits, 1);
+        alignas(32) float tNear[WideBVHNode::kWidth];
+        uint32_t mask = node.IntersectChildren(ray.origin, invDir, ray.tMin, ray.tMax, tNear);
+        //击中的子节点按距离由远到近入栈，近处子节点先出栈
+        int begin = stackSize;
+        for (int i = 0; i < node.childCount; ++i)
+        {
+            if (!(mask & (1u << i)))
+            {
+                continue;
+            }
+            StackEntry child{node.children[i], node.primitiveCounts[i], tNear[i]};
+            int j = stackSize++;
+            while (j > begin && stack[j - 1].tNear < child.tNear)
+            {
+                stack[j] = stack[j - 1];
+                --j;
+            }
+            stack[j] = child;
+        }
+    }
+    if (isHit && !isShadow)
+    {
+        record.hitMesh = meshes[hitMesh];
+    }
+    return isHit;
+}
+bool WideBVHAccel::Occluded(const Ray &ray, float tMax) const
+{
+    if (wideTree.empty())
+    {
+        return BVHAccel::Occluded(ray, tMax);
+    }
+    Ray shadowRay = ray;
+    shadowRay.tMax = std::min(ray.tMax, tMax);
+    //任意交点即可，子节点无需排序
+    struct StackEntry
+    {
+        uint32_t index;
+        uint16_t primitiveCount;
+    };
+    StackEntry stack[kMaxStackSize * WideBVHNode::kWidth];
+    int stackSize = 0;
+    stack[stackSize++] = {0, 0};
+    Vector3f invDir = 1.0f / shadowRay.direction;
+    while (stackSize > 0)
+    {
+        auto entry = stack[--stackSize];
+        if (entry.primitiveCount > 0)
+        {
+            if (OccludedLeaf(entry.index, entry.primitiveCount, shadowRay))
+            {
+                return true;
+            }
+            continue;
+        }
+        const auto &node = wideTree[entry.index];
+        ACCEL_STATS_ADD(nodeVisits, 1);
+        alignas(32) float tNear[WideBVHNode::kWidth];
+        uint32_t mask = node.IntersectChildren(shadowRay.origin, invDir, shadowRay.tMin, shadowRay.tMax, tNear);
+        for (int i = 0; i < node.childCount; ++i)
+        {
+            if (mask & (1u << i))
+            {
+                stack[stackSize++] = {node.children[i], node.primitiveCounts[i]};
+            }
+        }
+    }
+    return false;
+}
\ No newline at end of file
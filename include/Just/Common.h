@@ -22,6 +22,14 @@
 
 //定义
 #define ENABLE_OPENMP //开启OpenMP
+//SIMD指令集，由编译选项决定
+#if defined(__AVX2__)
+#define ENABLE_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#define ENABLE_SSE
+#include <emmintrin.h>
+#endif
 //全局常量
 constexpr float kPI = 3.14159265358979323846f;
 constexpr float kInvPI = 0.31830988618379067154f;
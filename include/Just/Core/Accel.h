@@ -3,13 +3,22 @@
 #include "Just/Common.h"
 #include "Just/Geometry/Mesh.h"
 #include "Just/Geometry/Bounds.h"
+#include "Just/Geometry/RayPacket.h"
+#include "Just/Geometry/Frustum.h"
 #include "Just/Core/RenderContext.h"
+#include "Just/Tool/Cache.h"
+#include "Just/Core/AccelStats.h"
 
 enum class AccelType
 {
     NaiveAccel = 0,
     BVHAccel = 1,
     OctreeAccel = 2,
+    LBVHAccel = 3,
+    InstanceAccel = 4,
+    WideBVHAccel = 5,
+    SBVHAccel = 6,
+    CompressedBVHAccel = 7,
 };
 
 struct AccelNode
@@ -30,18 +39,51 @@ public:
     virtual ~Accel() = default;
     void AddMesh(const std::shared_ptr<Mesh> &mesh);
     //通用部分
-    void Reset();
-    void Build();
+    virtual void Reset();
+    virtual void Build();
+    //网格顶点变化后更新加速结构
+    virtual void Refit(size_t meshIndex);
     //光栅化部分
-    virtual void StaticCulling() = 0;
+    //视锥剔除，与视锥相交的叶子中的图元追加到visibleFaces
+    virtual void StaticCulling(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const = 0;
+    //视锥与遮挡剔除，按由近到远的顺序把可见叶子的图元交给visitLeaf，isOccluded返回true的节点整体跳过
+    //visitLeaf中绘制的图元会更新遮挡信息，之后的节点测试可以利用；默认按网格由近到远提交并逐个网格测试遮挡
+    virtual void OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                                  const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const;
     //光线追踪部分
     //射线相交测试
     bool RayIntersect(const Ray &ray, HitRecord &record, bool isShadow) const;
     bool RayIntersect(const Ray &ray, bool shadow) const;
+    //射线包相交测试，最多8条射线，返回击中射线的位掩码
+    uint32_t RayIntersectPacket8(const Ray *rays, HitRecord *records, int count) const;
+    //遍历加速结构求交，返回击中图元的面索引
+    virtual bool Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const;
+    //遮挡查询，只判断射线在[tMin, tMax]范围内是否被遮挡
+    //所有加速结构与最近交点求交都使用同一区间，tMin用于偏移阴影射线起点，避免自相交
+    virtual bool Occluded(const Ray &ray, float tMax) const;
+    //射线包遍历加速结构求交，默认逐条求交
+    virtual uint32_t IntersectPacket8(const Ray *rays, HitRecord *records, size_t *hitFaces, int count) const;
+    //插值计算交点信息
+    virtual void Interpolate(HitRecord &record, size_t faceIndex) const;
+    //构建完成后整理树结构
+    virtual void Flatten() {}
     //划分子节点
     virtual void Divide(size_t nodeIndex, std::vector<AccelNode> &children) = 0;
     //遍历子节点
     virtual void Traverse(const Ray &ray, size_t nodeIndex, std::queue<size_t> &queue) const = 0;
+    //统计部分
+    //树结构统计，遍历计数由Scene合并
+    virtual AccelStats CollectStats() const;
+    //缓存部分
+    //网格数据与构建参数的哈希，作为缓存文件的键
+    virtual uint64_t ContentHash() const;
+    //写入构建结果，不支持缓存的加速结构返回false
+    virtual bool SaveCache(const std::string &path) const { return false; }
+    //读取构建结果代替Build，键不匹配或文件损坏时返回false
+    virtual bool LoadCache(const std::string &path) { return false; }
+protected:
+    //通用树的视锥剔除，逐个测试叶子节点
+    void CullTreeLeaves(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const;
 public:
     std::vector<std::shared_ptr<Mesh>> meshes;
     //加速结构树
@@ -79,10 +121,108 @@ void Accel::AddMesh(const std::shared_ptr<Mesh> &mesh)
     meshes.push_back(mesh);
     std::cout << "[info]: success to add mesh." << "\n";
 }
+AccelStats Accel::CollectStats() const
+{
+    AccelStats stats;
+    stats.type = ReadableTypeName(typeid(*this));
+    stats.nodeCount = nodeCount;
+    stats.leafCount = leafCount;
+    stats.maxDepth = currDepth;
+    if (tree.empty())
+    {
+        return stats;
+    }
+    //层次构建时按下标顺序处理节点，每个内部节点的子节点范围到下一个内部节点的子节点为止
+    std::vector<int> depths(tree.size(), 0);
+    std::vector<size_t> interiors;
+    for (size_t i = 0; i < tree.size(); ++i)
+    {
+        if (tree[i].child != 0)
+        {
+            interiors.push_back(i);
+        }
+    }
+    for (size_t k = 0; k < interiors.size(); ++k)
+    {
+        size_t end = k + 1 < interiors.size() ? tree[interiors[k + 1]].child : tree.size();
+        for (size_t c = tree[interiors[k]].child; c < end; ++c)
+        {
+            depths[c] = depths[interiors[k]] + 1;
+        }
+    }
+    for (size_t i = 0; i < tree.size(); ++i)
+    {
+        if (tree[i].child == 0)
+        {
+            stats.AddLeaf(static_cast<uint32_t>(tree[i].faceIndices.size()), depths[i]);
+        }
+    }
+    return stats;
+}
+void Accel::OcclusionCulling(const Frustum &frustum, const std::function<bool(const Bounds3f &)> &isOccluded,
+                             const std::function<void(const std::pair<size_t, size_t> *, size_t)> &visitLeaf) const
+{
+    std::vector<std::pair<size_t, size_t>> visibleFaces;
+    StaticCulling(frustum, visibleFaces);
+    //没有层次结构时按网格包围盒由近到远提交，先绘制的网格更新遮挡信息后，整体被遮挡的网格可以跳过
+    std::vector<float> meshDepths(meshes.size());
+    for (size_t i = 0; i < meshes.size(); ++i)
+    {
+        meshDepths[i] = frustum.Depth(meshes[i]->bounds.Centroid());
+    }
+    //同一网格的图元保持原有顺序并连续排列
+    std::stable_sort(visibleFaces.begin(), visibleFaces.end(),
+                     [&meshDepths](const std::pair<size_t, size_t> &a, const std::pair<size_t, size_t> &b) {
+                         return meshDepths[a.first] < meshDepths[b.first] ||
+                                (meshDepths[a.first] == meshDepths[b.first] && a.first < b.first);
+                     });
+    for (size_t begin = 0, end = 0; begin < visibleFaces.size(); begin = end)
+    {
+        auto meshIndex = visibleFaces[begin].first;
+        while (end < visibleFaces.size() && visibleFaces[end].first == meshIndex)
+        {
+            ++end;
+        }
+        if (!isOccluded(meshes[meshIndex]->bounds))
+        {
+            visitLeaf(visibleFaces.data() + begin, end - begin);
+        }
+    }
+}
+void Accel::CullTreeLeaves(const Frustum &frustum, std::vector<std::pair<size_t, size_t>> &visibleFaces) const
+{
+    auto begin = visibleFaces.size();
+    for (const auto &node: tree)
+    {
+        if (node.child == 0 && frustum.Intersect(node.bounds))
+        {
+            visibleFaces.insert(visibleFaces.end(), node.faceIndices.begin(), node.faceIndices.end());
+        }
+    }
+    //空间划分的叶子可能共享图元，去掉重复项
+    std::sort(visibleFaces.begin() + begin, visibleFaces.end());
+    visibleFaces.erase(std::unique(visibleFaces.begin() + begin, visibleFaces.end()), visibleFaces.end());
+}
+uint64_t Accel::ContentHash() const
+{
+    //只有顶点位置与索引影响构建结果
+    uint64_t hash = HashBytes(typeid(*this).name(), std::strlen(typeid(*this).name()));
+    hash = HashValue(minNumFaces, hash);
+    hash = HashValue(maxDepth, hash);
+    for (const auto &mesh: meshes)
+    {
+        hash = HashVector(mesh->positions, hash);
+        hash = HashVector(mesh->indices, hash);
+    }
+    return hash;
+}
 void Accel::Build()
 {
     //计算场景包围盒
     std::cout << "[info]: building accel......" << "\n";
+    currDepth = 0;
+    leafCount = 1;
+    nodeCount = 1;
     //初始化根节点
     auto root = AccelNode(bounds, faceIndices.size());
     root.faceIndices = faceIndices;
@@ -130,13 +270,24 @@ void Accel::Build()
     std::cout << "[tree depth]: " << currDepth << std::endl;
     std::cout << "[node count]: " << nodeCount << std::endl;
     std::cout << "[leaf count]: " << leafCount << std::endl;
+    Flatten();
 }
-bool Accel::RayIntersect(const Ray &ray, HitRecord &record, bool isShadow = false) const
+void Accel::Refit(size_t meshIndex)
+{
+    //通用树的节点划分依赖图元位置，直接重新构建
+    meshes[meshIndex]->UpdateBounds();
+    bounds = Bounds3f();
+    for (const auto &mesh: meshes)
+    {
+        bounds.Expand(mesh->bounds);
+    }
+    Build();
+}
+bool Accel::Intersect(const Ray &ray, HitRecord &record, size_t &hitFace, bool isShadow) const
 {
     //初始化辅助队列
     std::queue<size_t> q;
     q.push(0);
-    auto [m, f] = std::tuple<size_t, size_t>();
     bool isHit = false;
     //层次遍历树
     while (!q.empty())
@@ -146,6 +297,7 @@ bool Accel::RayIntersect(const Ray &ray, HitRecord &record, bool isShadow = fals
         {
             auto nodeIndex = q.front();
             q.pop();
+            ACCEL_STATS_ADD(nodeVisits, 1);
             //包围盒相交测试
             if (!tree[nodeIndex].bounds.RayIntersect(ray))
             {
@@ -157,6 +309,7 @@ bool Accel::RayIntersect(const Ray &ray, HitRecord &record, bool isShadow = fals
                 //遍历节点内图元进行相交测试
                 for (auto [meshIndex, faceIndex]: tree[nodeIndex].faceIndices)
                 {
+                    ACCEL_STATS_ADD(triangleTests, 1);
                     if (meshes[meshIndex]->RayIntersect(faceIndex, ray, record))
                     {
                         //阴影测试击中直接返回
@@ -166,7 +319,7 @@ bool Accel::RayIntersect(const Ray &ray, HitRecord &record, bool isShadow = fals
                         }
                         //记录交点信息
                         record.hitMesh = meshes[meshIndex];
-                        f = faceIndex;
+                        hitFace = faceIndex;
                         isHit = true;
                     }
                 }
@@ -183,58 +336,107 @@ bool Accel::RayIntersect(const Ray &ray, HitRecord &record, bool isShadow = fals
             }
         }
     }
+    return isHit;
+}
+bool Accel::RayIntersect(const Ray &ray, HitRecord &record, bool isShadow = false) const
+{
+    size_t f = 0;
+    bool isHit = Intersect(ray, record, f, isShadow);
 
-    //阴影射线未击中物体
+    //阴影射线只关心是否击中
     if (isShadow)
     {
-        return false;
+        return isHit;
     }
 
     //击中物体，插值计算
     if (isHit)
     {
-        //计算重心坐标
-        Vector3f bary;
-        bary.x = 1 - record.uv.x - record.uv.y;
-        bary.y = record.uv.x;
-        bary.z = record.uv.y;
+        Interpolate(record, f);
+    }
+    return isHit;
+}
+void Accel::Interpolate(HitRecord &record, size_t f) const
+{
+    //计算重心坐标
+    Vector3f bary;
+    bary.x = 1 - record.uv.x - record.uv.y;
+    bary.y = record.uv.x;
+    bary.z = record.uv.y;
 
-        //网格缓冲引用
-        const auto &recordMesh = record.hitMesh;
-        const auto &V = recordMesh->positions;
-        const auto &N = recordMesh->normals;
-        const auto &UV = recordMesh->texcoords;
-        //获取顶点索引
-        const auto [idx0, idx1, idx2] = recordMesh->GetTriangleIndices(f);
+    //网格缓冲引用
+    const auto &recordMesh = record.hitMesh;
+    const auto &V = recordMesh->positions;
+    const auto &N = recordMesh->normals;
+    const auto &UV = recordMesh->texcoords;
+    //获取顶点索引
+    const auto [idx0, idx1, idx2] = recordMesh->GetTriangleIndices(f);
 
-        //插值顶点
-        record.hitPoint = bary.x * V[idx0] + bary.y * V[idx1] + bary.z * V[idx2];
+    //插值顶点
+    record.hitPoint = bary.x * V[idx0] + bary.y * V[idx1] + bary.z * V[idx2];
 
-        //插值纹理坐标
-        if (!UV.empty())
-        {
-            record.uv = bary.x * UV[idx0] + bary.y * UV[idx1] + bary.z * UV[idx2];
-        }
+    //插值纹理坐标
+    if (!UV.empty())
+    {
+        record.uv = bary.x * UV[idx0] + bary.y * UV[idx1] + bary.z * UV[idx2];
+    }
 
-        //面法线坐标系
-        record.geoFrame = Frame(Normalize(Cross(V[idx1] - V[idx0], V[idx2] - V[idx0])));
+    //面法线坐标系
+    record.geoFrame = Frame(Normalize(Cross(V[idx1] - V[idx0], V[idx2] - V[idx0])));
 
-        //插值法线坐标系
-        if (!recordMesh->normals.empty())
-        {
-            record.shFrame = Frame(Normalize(bary.x * N[idx0] + bary.y * N[idx1] + bary.z * N[idx2]));
-        }
-        else
-        {
-            record.shFrame = record.geoFrame;
-        }
+    //插值法线坐标系
+    if (!recordMesh->normals.empty())
+    {
+        record.shFrame = Frame(Normalize(bary.x * N[idx0] + bary.y * N[idx1] + bary.z * N[idx2]));
+    }
+    else
+    {
+        record.shFrame = record.geoFrame;
     }
-    return isHit;
 }
 bool Accel::RayIntersect(const Ray &ray, bool shadow = true) const
 {
+    if (shadow)
+    {
+        return Occluded(ray, ray.tMax);
+    }
     HitRecord unused;
     return RayIntersect(ray, unused, shadow);
 }
+bool Accel::Occluded(const Ray &ray, float tMax) const
+{
+    //通用树沿用阴影射线的层次遍历
+    Ray shadowRay = ray;
+    shadowRay.tMax = std::min(ray.tMax, tMax);
+    HitRecord unused;
+    size_t hitFace = 0;
+    return Intersect(shadowRay, unused, hitFace, true);
+}
+uint32_t Accel::IntersectPacket8(const Ray *rays, HitRecord *records, size_t *hitFaces, int count) const
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (Intersect(rays[i], records[i], hitFaces[i], false))
+        {
+            mask |= 1u << i;
+        }
+    }
+    return mask;
+}
+uint32_t Accel::RayIntersectPacket8(const Ray *rays, HitRecord *records, int count) const
+{
+    size_t hitFaces[RayPacket8::kSize] = {};
+    uint32_t mask = IntersectPacket8(rays, records, hitFaces, count);
+    //击中的射线逐条插值
+    for (int i = 0; i < count; ++i)
+    {
+        if (mask & (1u << i))
+        {
+            Interpolate(records[i], hitFaces[i]);
+        }
+    }
+    return mask;
+}
 
 
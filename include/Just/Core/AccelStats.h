@@ -0,0 +1,169 @@
+#pragma once
+
+#include "Just/Common.h"
+
+#include <cstring>
+#include <mutex>
+#include <typeinfo>
+
+//遍历计数，定义ENABLE_ACCEL_STATS时由遍历代码累加
+struct TraversalCounters
+{
+    uint64_t rayCount = 0;
+    uint64_t nodeVisits = 0;
+    uint64_t triangleTests = 0;
+    TraversalCounters &operator+=(const TraversalCounters &rhs)
+    {
+        rayCount += rhs.rayCount;
+        nodeVisits += rhs.nodeVisits;
+        triangleTests += rhs.triangleTests;
+        return *this;
+    }
+};
+
+//各线程的计数器注册到全局列表，渲染结束时合并，线程退出时计数转入retired
+struct TraversalCounterRegistry
+{
+public:
+    static TraversalCounterRegistry &GetInstance()
+    {
+        static TraversalCounterRegistry instance;
+        return instance;
+    }
+    void Register(TraversalCounters *counters)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        threadCounters.push_back(counters);
+    }
+    void Unregister(TraversalCounters *counters)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        retired += *counters;
+        threadCounters.erase(std::remove(threadCounters.begin(), threadCounters.end(), counters),
+                             threadCounters.end());
+    }
+    //合并所有线程的计数并清零，调用时不应有线程正在遍历
+    TraversalCounters Merge()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        TraversalCounters total = retired;
+        retired = TraversalCounters();
+        for (auto counters: threadCounters)
+        {
+            total += *counters;
+            *counters = TraversalCounters();
+        }
+        return total;
+    }
+private:
+    std::mutex mutex;
+    std::vector<TraversalCounters *> threadCounters;
+    TraversalCounters retired;
+};
+
+struct ThreadTraversalCounters : public TraversalCounters
+{
+    ThreadTraversalCounters() { TraversalCounterRegistry::GetInstance().Register(this); }
+    ~ThreadTraversalCounters() { TraversalCounterRegistry::GetInstance().Unregister(this); }
+};
+
+//当前线程的计数器
+inline TraversalCounters &LocalTraversalCounters()
+{
+    thread_local ThreadTraversalCounters counters;
+    return counters;
+}
+
+//统计关闭时计数宏为空，遍历代码没有额外开销
+#ifdef ENABLE_ACCEL_STATS
+#define ACCEL_STATS_ADD(field, value) (LocalTraversalCounters().field += (value))
+#else
+#define ACCEL_STATS_ADD(field, value) ((void)0)
+#endif
+
+//去掉typeid名称中的长度前缀（GCC/Clang）或struct/class前缀（MSVC）
+inline std::string ReadableTypeName(const std::type_info &info)
+{
+    std::string name = info.name();
+    for (const char *prefix: {"struct ", "class "})
+    {
+        if (name.rfind(prefix, 0) == 0)
+        {
+            return name.substr(std::strlen(prefix));
+        }
+    }
+    size_t begin = name.find_first_not_of("0123456789");
+    return begin == std::string::npos ? name : name.substr(begin);
+}
+
+//加速结构质量与遍历统计
+struct AccelStats
+{
+public:
+    //记录一个叶子节点，depth从0开始
+    void AddLeaf(uint32_t primitiveCount, int depth);
+    //输出JSON，便于在不同构建之间比较
+    std::string ToJson() const;
+public:
+    std::string type;
+    int nodeCount = 0;
+    int leafCount = 0;
+    int maxDepth = 0;
+    //叶子中的图元引用总数，空间划分时大于三角形数量
+    uint64_t primitiveReferences = 0;
+    //以根节点表面积归一化的SAH成本
+    float sahCost = 0.0f;
+    //索引为叶子图元数量
+    std::vector<uint64_t> leafSizeHistogram;
+    //索引为叶子深度
+    std::vector<uint64_t> depthHistogram;
+    TraversalCounters traversal;
+};
+
+inline void AccelStats::AddLeaf(uint32_t primitiveCount, int depth)
+{
+    if (leafSizeHistogram.size() <= primitiveCount)
+    {
+        leafSizeHistogram.resize(primitiveCount + 1, 0);
+    }
+    if (depthHistogram.size() <= static_cast<size_t>(depth))
+    {
+        depthHistogram.resize(depth + 1, 0);
+    }
+    ++leafSizeHistogram[primitiveCount];
+    ++depthHistogram[depth];
+    primitiveReferences += primitiveCount;
+}
+inline std::string AccelStats::ToJson() const
+{
+    auto writeArray = [](std::ostringstream &stream, const std::vector<uint64_t> &values) {
+        stream << "[";
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            stream << (i == 0 ? "" : ", ") << values[i];
+        }
+        stream << "]";
+    };
+    auto perRay = [this](uint64_t value) {
+        return traversal.rayCount == 0 ? 0.0 : static_cast<double>(value) / static_cast<double>(traversal.rayCount);
+    };
+    std::ostringstream stream;
+    stream << "{\n";
+    stream << "  \"type\": \"" << type << "\",\n";
+    stream << "  \"nodeCount\": " << nodeCount << ",\n";
+    stream << "  \"leafCount\": " << leafCount << ",\n";
+    stream << "  \"maxDepth\": " << maxDepth << ",\n";
+    stream << "  \"primitiveReferences\": " << primitiveReferences << ",\n";
+    stream << "  \"sahCost\": " << sahCost << ",\n";
+    stream << "  \"leafSizeHistogram\": ";
+    writeArray(stream, leafSizeHistogram);
+    stream << ",\n  \"depthHistogram\": ";
+    writeArray(stream, depthHistogram);
+    stream << ",\n  \"rayCount\": " << traversal.rayCount << ",\n";
+    stream << "  \"nodeVisits\": " << traversal.nodeVisits << ",\n";
+    stream << "  \"triangleTests\": " << traversal.triangleTests << ",\n";
+    stream << "  \"nodeVisitsPerRay\": " << perRay(traversal.nodeVisits) << ",\n";
+    stream << "  \"triangleTestsPerRay\": " << perRay(traversal.triangleTests) << "\n";
+    stream << "}";
+    return stream.str();
+}
\ No newline at end of file
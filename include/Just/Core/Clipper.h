@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Math/Transform.h"
+#include "Just/Core/EdgeFunction.h"
+#include "Just/Core/VertexCache.h"
+
+//齐次裁剪空间中多边形的顶点，weights为相对原三角形三个顶点的重心坐标，用于插值顶点属性
+struct ClipVertex
+{
+    Point4f pos;
+    Vector3f weights;
+};
+
+//三角形依次被近平面、远平面与保护带的四个平面裁剪，每个平面最多增加一个顶点
+constexpr int kMaxClipVertices = 9;
+
+//保护带：裁剪空间中|x|、|y|不超过guardBand * w的顶点不必裁剪，超出屏幕的部分由光栅化的矩形范围去掉
+//保护带在屏幕上的范围不超过当前子像素精度下边函数允许的范围，精度由分辨率决定，屏幕总在该范围内
+inline float GuardBand(const Transform &screenToRaster, int subPixelBits)
+{
+    float scale = std::max(std::abs(screenToRaster.matrix[0][0]), std::abs(screenToRaster.matrix[1][1]));
+    return std::max(1.0f, EdgeFunctions::MaxExtent(subPixelBits) / (2.0f * scale));
+}
+
+//Sutherland-Hodgman裁剪，只裁剪clipCodes中标记的近平面、远平面与保护带
+//positions为三角形顶点的裁剪空间坐标，结果写入polygon，顶点顺序保持三角形的环绕方向，返回顶点数，完全被裁掉时返回0
+inline int ClipTriangle(const Point4f *positions, uint8_t clipCodes, float guardBand, ClipVertex *polygon)
+{
+    //平面(a,b,c,d)，ax+by+cz+dw>=0的点在内侧
+    const struct
+    {
+        uint8_t code;
+        float a, b, c, d;
+    } planes[] = {
+            {ClipVertices::kOutsideNear,   0.0f,  0.0f,  1.0f,  0.0f},
+            {ClipVertices::kOutsideFar,    0.0f,  0.0f,  -1.0f, 1.0f},
+            {ClipVertices::kOutsideGuardX, 1.0f,  0.0f,  0.0f,  guardBand},
+            {ClipVertices::kOutsideGuardX, -1.0f, 0.0f,  0.0f,  guardBand},
+            {ClipVertices::kOutsideGuardY, 0.0f,  1.0f,  0.0f,  guardBand},
+            {ClipVertices::kOutsideGuardY, 0.0f,  -1.0f, 0.0f,  guardBand},
+    };
+    ClipVertex buffer[kMaxClipVertices];
+    ClipVertex *input = polygon, *output = buffer;
+    int count = 3;
+    for (int i = 0; i < 3; ++i)
+    {
+        input[i].pos = positions[i];
+        input[i].weights = Vector3f(i == 0 ? 1.0f : 0.0f, i == 1 ? 1.0f : 0.0f, i == 2 ? 1.0f : 0.0f);
+    }
+    //交点总是从内侧顶点向外侧顶点插值，相邻三角形的公共边得到相同的交点
+    auto lerp = [](const ClipVertex &inside, const ClipVertex &outside, float t) {
+        return ClipVertex{inside.pos + t * (outside.pos - inside.pos),
+                          inside.weights + t * (outside.weights - inside.weights)};
+    };
+    for (const auto &plane: planes)
+    {
+        if (!(clipCodes & plane.code))
+        {
+            continue;
+        }
+        auto distance = [&plane](const ClipVertex &vertex) {
+            return plane.a * vertex.pos.x + plane.b * vertex.pos.y + plane.c * vertex.pos.z + plane.d * vertex.pos.w;
+        };
+        int outputCount = 0;
+        for (int i = 0; i < count; ++i)
+        {
+            const auto &current = input[i];
+            const auto &next = input[(i + 1) % count];
+            float currentDistance = distance(current), nextDistance = distance(next);
+            if (currentDistance >= 0.0f)
+            {
+                output[outputCount++] = current;
+                if (nextDistance < 0.0f)
+                {
+                    output[outputCount++] = lerp(current, next, currentDistance / (currentDistance - nextDistance));
+                }
+            }
+            else if (nextDistance >= 0.0f)
+            {
+                output[outputCount++] = lerp(next, current, nextDistance / (nextDistance - currentDistance));
+            }
+        }
+        std::swap(input, output);
+        count = outputCount;
+        if (count < 3)
+        {
+            return 0;
+        }
+    }
+    if (input != polygon)
+    {
+        std::copy(input, input + count, polygon);
+    }
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Core/RasterVertex.h"
+
+//三角形的三个边函数E(x,y) = a * x + b * y + c，像素坐标为整数，点在三角形内时三个值都不小于0
+//顶点坐标先吸附到子像素的定点数，边函数用整数计算，相邻三角形的公共边结果一致
+//顶点的屏幕坐标范围乘以子像素数不超过kMaxExtent * kSubPixelScale时，边函数不会溢出32位整数
+struct EdgeFunctions
+{
+public:
+    //最高子像素精度，1/16像素
+    static constexpr int kSubPixelBits = 4;
+    static constexpr int kSubPixelScale = 1 << kSubPixelBits;
+    //最高精度下顶点屏幕坐标范围的上限（像素），由裁剪的保护带保证，留出像素块越过三角形边界的余量
+    static constexpr float kMaxExtent = 1920.0f;
+    //分辨率超过kMaxExtent时逐位降低子像素精度，保持定点坐标的范围不变，分辨率不应超过kMaxExtent * kSubPixelScale
+    static int SubPixelBits(const Point2i &res);
+    //子像素位数为subPixelBits时顶点屏幕坐标范围的上限（像素）
+    static float MaxExtent(int subPixelBits)
+    {
+        return kMaxExtent * static_cast<float>(1 << (kSubPixelBits - subPixelBits));
+    }
+    //建立边函数，顶点吸附到1/2^subPixelBits像素，退化三角形返回false
+    bool Setup(const RasterVertex *vertices, int subPixelBits = kSubPixelBits);
+    //边函数在像素(x, y)处的值
+    int32_t Evaluate(int edge, int x, int y) const
+    {
+        return static_cast<int32_t>(static_cast<int64_t>(a[edge]) * x + static_cast<int64_t>(b[edge]) * y + c[edge]);
+    }
+public:
+    //第k条边与第k个顶点相对，边函数值除以两倍面积为第k个顶点的重心坐标
+    int32_t a[3], b[3];
+    int64_t c[3];
+    float invArea = 0.0f;
+    //顶点1与顶点2是否交换过，保证边函数在三角形内为正
+    bool isSwapped = false;
+};
+
+inline int EdgeFunctions::SubPixelBits(const Point2i &res)
+{
+    int subPixelBits = kSubPixelBits;
+    while (subPixelBits > 0 && static_cast<float>(std::max(res.x, res.y)) > MaxExtent(subPixelBits))
+    {
+        --subPixelBits;
+    }
+    return subPixelBits;
+}
+inline bool EdgeFunctions::Setup(const RasterVertex *vertices, int subPixelBits)
+{
+    const int64_t scale = int64_t(1) << subPixelBits;
+    int64_t x[3], y[3];
+    for (int i = 0; i < 3; ++i)
+    {
+        x[i] = std::llround(vertices[i].pos2f.x * static_cast<float>(scale));
+        y[i] = std::llround(vertices[i].pos2f.y * static_cast<float>(scale));
+    }
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+    if (area == 0)
+    {
+        return false;
+    }
+    isSwapped = area < 0;
+    if (isSwapped)
+    {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        area = -area;
+    }
+    invArea = 1.0f / static_cast<float>(area);
+    for (int k = 0; k < 3; ++k)
+    {
+        int i = (k + 1) % 3, j = (k + 2) % 3;
+        int64_t dx = x[j] - x[i], dy = y[j] - y[i];
+        //E = dx * (py - yi) - dy * (px - xi)，采样点px = x * scale
+        a[k] = static_cast<int32_t>(-dy * scale);
+        b[k] = static_cast<int32_t>(dx * scale);
+        c[k] = dy * x[i] - dx * y[i];
+        //top-left规则：采样点正好落在边上时只属于上边或左边，非上边与左边的边界点排除在外
+        bool isTopLeft = (dy == 0 && dx > 0) || dy < 0;
+        if (!isTopLeft)
+        {
+            c[k] -= 1;
+        }
+    }
+    return true;
+}
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include "Just/Math/Color.h"
 #include "Just/Geometry/Bounds.h"
 #include "Just/Texture/Texture2D.h"
+#include "Just/Core/HiZBuffer.h"
+#include "Just/Core/GBuffer.h"
 
 struct FrameBuffer
 {
@@ -12,16 +14,30 @@ public:
     float *depthBuffer;
     Point2i res;
     Bounds2i screenRect;
+    //与depthBuffer同步维护的层次深度缓冲
+    HiZBuffer hiZ;
+    //延迟渲染的几何缓冲，只在延迟绘制时分配
+    GBuffer gBuffer;
     explicit FrameBuffer(const Point2i &res) :
             res{res},
-            screenRect{0, 0, res.x - 1, res.y - 1}
+            screenRect{0, 0, res.x - 1, res.y - 1},
+            hiZ{res}
     {
         colorBuffer = new RGBA32[res.x * res.y];
         depthBuffer = new float[res.x * res.y];
+        Clear();
     }
     ~FrameBuffer()
     {
         delete[] colorBuffer;
         delete[] depthBuffer;
     }
+    //深度缓冲保存1/w，清除为0即无穷远
+    void Clear()
+    {
+        std::fill(colorBuffer, colorBuffer + res.x * res.y, RGBA32());
+        std::fill(depthBuffer, depthBuffer + res.x * res.y, 0.0f);
+        hiZ.Clear(0.0f);
+        gBuffer.Clear();
+    }
 };
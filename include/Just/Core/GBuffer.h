@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Math/Vector.h"
+#include "Just/Core/RasterVertex.h"
+
+//G-buffer中一个像素的可见表面，延迟渲染的着色阶段只读取这些数据
+struct GBufferSample
+{
+    //没有表面覆盖的像素
+    static constexpr uint32_t kInvalidMesh = std::numeric_limits<uint32_t>::max();
+    //透视校正插值后的顶点位置（网格坐标系）、法线与纹理坐标
+    Point3f position;
+    Vector3f normal;
+    Point2f texcoord;
+    //网格索引对应场景中网格的材质，面索引可用于从表面继续发射光线
+    uint32_t meshIndex = kInvalidMesh;
+    uint32_t faceIndex = 0;
+    bool IsValid() const { return meshIndex != kInvalidMesh; }
+};
+
+//延迟渲染的几何缓冲，深度使用帧缓冲的depthBuffer，第一次延迟绘制时才分配
+struct GBuffer
+{
+public:
+    void Resize(const Point2i &res) { samples.resize(res.x * res.y); }
+    void Clear() { std::fill(samples.begin(), samples.end(), GBufferSample()); }
+    bool IsEmpty() const { return samples.empty(); }
+public:
+    std::vector<GBufferSample> samples;
+};
+
+//由透视校正后的重心坐标插值表面数据
+inline GBufferSample InterpolateSurface(const RasterVertex *triangle, float alpha, float beta, float gamma)
+{
+    GBufferSample sample;
+    sample.position = alpha * triangle[0].pos + beta * triangle[1].pos + gamma * triangle[2].pos;
+    sample.normal = alpha * triangle[0].normal + beta * triangle[1].normal + gamma * triangle[2].normal;
+    sample.texcoord = alpha * triangle[0].texcoord + beta * triangle[1].texcoord + gamma * triangle[2].texcoord;
+    return sample;
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Geometry/Bounds.h"
+
+#include <atomic>
+
+//遮挡剔除统计，定义ENABLE_ACCEL_STATS时由光栅化代码累加
+struct OcclusionStats
+{
+public:
+    void Reset();
+    //输出JSON，包含各层级的剔除比例
+    std::string ToJson() const;
+public:
+    std::atomic<uint64_t> nodesTested{0};
+    std::atomic<uint64_t> nodesCulled{0};
+    std::atomic<uint64_t> trianglesTested{0};
+    std::atomic<uint64_t> trianglesCulled{0};
+    std::atomic<uint64_t> tilesTested{0};
+    std::atomic<uint64_t> tilesCulled{0};
+    //着色的片元数量与最终被覆盖的像素数量，二者之比为过度绘制
+    std::atomic<uint64_t> fragmentsShaded{0};
+    std::atomic<uint64_t> pixelsCovered{0};
+};
+
+#ifdef ENABLE_ACCEL_STATS
+#define OCCLUSION_STATS_ADD(stats, field, value) ((stats).field.fetch_add((value), std::memory_order_relaxed))
+#else
+#define OCCLUSION_STATS_ADD(stats, field, value) ((void)0)
+#endif
+
+inline void OcclusionStats::Reset()
+{
+    for (auto *counter: {&nodesTested, &nodesCulled, &trianglesTested, &trianglesCulled, &tilesTested, &tilesCulled,
+                         &fragmentsShaded, &pixelsCovered})
+    {
+        counter->store(0, std::memory_order_relaxed);
+    }
+}
+inline std::string OcclusionStats::ToJson() const
+{
+    auto percent = [](uint64_t culled, uint64_t tested) {
+        return tested == 0 ? 0.0 : 100.0 * static_cast<double>(culled) / static_cast<double>(tested);
+    };
+    std::ostringstream stream;
+    stream << "{\n";
+    stream << "  \"nodesTested\": " << nodesTested << ",\n";
+    stream << "  \"nodesCulled\": " << nodesCulled << ",\n";
+    stream << "  \"nodesCulledPercent\": " << percent(nodesCulled, nodesTested) << ",\n";
+    stream << "  \"trianglesTested\": " << trianglesTested << ",\n";
+    stream << "  \"trianglesCulled\": " << trianglesCulled << ",\n";
+    stream << "  \"trianglesCulledPercent\": " << percent(trianglesCulled, trianglesTested) << ",\n";
+    stream << "  \"tilesTested\": " << tilesTested << ",\n";
+    stream << "  \"tilesCulled\": " << tilesCulled << ",\n";
+    stream << "  \"tilesCulledPercent\": " << percent(tilesCulled, tilesTested) << ",\n";
+    stream << "  \"fragmentsShaded\": " << fragmentsShaded << ",\n";
+    stream << "  \"pixelsCovered\": " << pixelsCovered << ",\n";
+    stream << "  \"overdraw\": " << percent(fragmentsShaded, pixelsCovered) / 100.0 << "\n";
+    stream << "}";
+    return stream.str();
+}
+
+//层次深度缓冲，第0层每个单元对应8x8像素块，之后每层2x2合并
+//深度缓冲保存1/w，单元保存块内最小值即最远深度；深度只会变近，未更新的单元仍是保守值
+struct HiZBuffer
+{
+public:
+    static constexpr int kTileSize = 8;
+    explicit HiZBuffer(const Point2i &res);
+    //与深度缓冲一同清除
+    void Clear(float depth);
+    //标记矩形范围内的块需要更新，可在多线程中调用
+    void MarkDirty(const Bounds2i &rect);
+    //从深度缓冲重新计算标记过的块及其上层单元
+    void Update(const float *depthBuffer);
+    //矩形范围内最近深度为rhw的图元是否被完全遮挡
+    bool IsOccluded(const Bounds2i &rect, float rhw) const;
+    //第0层块的最远深度
+    float TileDepth(int tileX, int tileY) const { return levels[0][tileX + tileY * levelRes[0].x]; }
+public:
+    Point2i res;
+    std::vector<Point2i> levelRes;
+    std::vector<std::vector<float>> levels;
+    //每层单元是否需要更新
+    std::vector<std::vector<uint8_t>> dirty;
+    OcclusionStats stats;
+};
+
+inline HiZBuffer::HiZBuffer(const Point2i &res) : res(res)
+{
+    Point2i levelSize{(res.x + kTileSize - 1) / kTileSize, (res.y + kTileSize - 1) / kTileSize};
+    while (true)
+    {
+        levelRes.push_back(levelSize);
+        levels.emplace_back(levelSize.x * levelSize.y, 0.0f);
+        dirty.emplace_back(levelSize.x * levelSize.y, 0);
+        if (levelSize.x == 1 && levelSize.y == 1)
+        {
+            break;
+        }
+        levelSize = Point2i{(levelSize.x + 1) / 2, (levelSize.y + 1) / 2};
+    }
+}
+inline void HiZBuffer::Clear(float depth)
+{
+    for (size_t level = 0; level < levels.size(); ++level)
+    {
+        std::fill(levels[level].begin(), levels[level].end(), depth);
+        std::fill(dirty[level].begin(), dirty[level].end(), 0);
+    }
+    stats.Reset();
+}
+inline void HiZBuffer::MarkDirty(const Bounds2i &rect)
+{
+    for (int y = rect.pMin.y / kTileSize; y <= rect.pMax.y / kTileSize; ++y)
+    {
+        for (int x = rect.pMin.x / kTileSize; x <= rect.pMax.x / kTileSize; ++x)
+        {
+            dirty[0][x + y * levelRes[0].x] = 1;
+        }
+    }
+}
+inline void HiZBuffer::Update(const float *depthBuffer)
+{
+    const Point2i &tiles = levelRes[0];
+    for (int ty = 0; ty < tiles.y; ++ty)
+    {
+        for (int tx = 0; tx < tiles.x; ++tx)
+        {
+            int index = tx + ty * tiles.x;
+            if (!dirty[0][index])
+            {
+                continue;
+            }
+            dirty[0][index] = 0;
+            float farthest = std::numeric_limits<float>::max();
+            int xEnd = std::min((tx + 1) * kTileSize, res.x);
+            int yEnd = std::min((ty + 1) * kTileSize, res.y);
+            for (int y = ty * kTileSize; y < yEnd; ++y)
+            {
+                for (int x = tx * kTileSize; x < xEnd; ++x)
+                {
+                    farthest = std::min(farthest, depthBuffer[x + y * res.x]);
+                }
+            }
+            levels[0][index] = farthest;
+            if (levels.size() > 1)
+            {
+                dirty[1][tx / 2 + ty / 2 * levelRes[1].x] = 1;
+            }
+        }
+    }
+    //上层单元取下层2x2单元的最小值
+    for (size_t level = 1; level < levels.size(); ++level)
+    {
+        const Point2i &size = levelRes[level];
+        const Point2i &childSize = levelRes[level - 1];
+        for (int y = 0; y < size.y; ++y)
+        {
+            for (int x = 0; x < size.x; ++x)
+            {
+                int index = x + y * size.x;
+                if (!dirty[level][index])
+                {
+                    continue;
+                }
+                dirty[level][index] = 0;
+                float farthest = std::numeric_limits<float>::max();
+                for (int cy = 2 * y; cy < std::min(2 * y + 2, childSize.y); ++cy)
+                {
+                    for (int cx = 2 * x; cx < std::min(2 * x + 2, childSize.x); ++cx)
+                    {
+                        farthest = std::min(farthest, levels[level - 1][cx + cy * childSize.x]);
+                    }
+                }
+                levels[level][index] = farthest;
+                if (level + 1 < levels.size())
+                {
+                    dirty[level + 1][x / 2 + y / 2 * levelRes[level + 1].x] = 1;
+                }
+            }
+        }
+    }
+}
+inline bool HiZBuffer::IsOccluded(const Bounds2i &rect, float rhw) const
+{
+    int x0 = rect.pMin.x / kTileSize, x1 = rect.pMax.x / kTileSize;
+    int y0 = rect.pMin.y / kTileSize, y1 = rect.pMax.y / kTileSize;
+    //选择矩形最多覆盖2x2个单元的层级
+    size_t level = 0;
+    while (level + 1 < levels.size() && (x1 - x0 > 1 || y1 - y0 > 1))
+    {
+        x0 >>= 1;
+        x1 >>= 1;
+        y0 >>= 1;
+        y1 >>= 1;
+        ++level;
+    }
+    for (int y = y0; y <= y1; ++y)
+    {
+        for (int x = x0; x <= x1; ++x)
+        {
+            if (rhw >= levels[level][x + y * levelRes[level].x])
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
\ No newline at end of file
@@ -13,5 +13,6 @@ struct HitRecord
     Frame shFrame;
     Frame geoFrame;
     Ref<Mesh> hitMesh;
-    HitRecord() : hitTime(0) {}
+    size_t hitInstance;
+    HitRecord() : hitTime(0), hitInstance(0) {}
 };
\ No newline at end of file
@@ -0,0 +1,275 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Core/FrameBuffer.h"
+#include "Just/Core/RasterVertex.h"
+#include "Just/Core/EdgeFunction.h"
+
+//完成几何阶段的三角形，顶点已变换到屏幕空间
+struct RasterTriangle
+{
+    RasterVertex vertices[3];
+    //屏幕上的矩形范围
+    Bounds2i rect;
+    //三个顶点中最近的深度(1/w)
+    float nearestRhw = 0.0f;
+    EdgeFunctions edges;
+    //三角形所属的网格与面，裁剪产生的三角形与原三角形相同
+    uint32_t meshIndex = 0;
+    uint32_t faceIndex = 0;
+};
+
+//分块光栅化的局部缓冲，每块只由一个线程读写，绘制完成后写回帧缓冲
+struct RasterTile
+{
+public:
+    //分块边长，局部颜色与深度缓冲共32KB，可以留在L1/L2缓存中
+    static constexpr int kSize = 64;
+    explicit RasterTile(const Bounds2i &rect) : rect(rect) {}
+    //从帧缓冲读取分块范围内的数据
+    void Load(const FrameBuffer &frameBuffer);
+    //写回帧缓冲
+    void Store(FrameBuffer &frameBuffer) const;
+    int Index(int x, int y) const { return (x - rect.pMin.x) + (y - rect.pMin.y) * kSize; }
+    //局部缓冲索引对应的像素坐标
+    Point2i Pixel(int index) const { return {rect.pMin.x + index % kSize, rect.pMin.y + index / kSize}; }
+public:
+    Bounds2i rect;
+    alignas(32) float depthBuffer[kSize * kSize];
+    alignas(32) RGBA32 colorBuffer[kSize * kSize];
+    //本分块着色的片元数量，用于统计过度绘制
+    uint32_t shadedCount = 0;
+};
+
+//深度测试方式
+enum class DepthTest
+{
+    //较近或相等的像素通过并写入深度
+    GreaterEqual,
+    //只有与深度缓冲相等的像素通过，不写入深度，用于深度预渲染之后的着色
+    Equal
+};
+
+inline void RasterTile::Load(const FrameBuffer &frameBuffer)
+{
+    int width = rect.pMax.x - rect.pMin.x + 1;
+    for (int y = rect.pMin.y; y <= rect.pMax.y; ++y)
+    {
+        int index = rect.pMin.x + y * frameBuffer.res.x;
+        std::copy(frameBuffer.depthBuffer + index, frameBuffer.depthBuffer + index + width,
+                  depthBuffer + Index(rect.pMin.x, y));
+        std::copy(frameBuffer.colorBuffer + index, frameBuffer.colorBuffer + index + width,
+                  colorBuffer + Index(rect.pMin.x, y));
+    }
+}
+inline void RasterTile::Store(FrameBuffer &frameBuffer) const
+{
+    int width = rect.pMax.x - rect.pMin.x + 1;
+    for (int y = rect.pMin.y; y <= rect.pMax.y; ++y)
+    {
+        int index = rect.pMin.x + y * frameBuffer.res.x;
+        std::copy(depthBuffer + Index(rect.pMin.x, y), depthBuffer + Index(rect.pMin.x, y) + width,
+                  frameBuffer.depthBuffer + index);
+        std::copy(colorBuffer + Index(rect.pMin.x, y), colorBuffer + Index(rect.pMin.x, y) + width,
+                  frameBuffer.colorBuffer + index);
+    }
+}
+
+//一行8个像素的覆盖与深度测试，DepthTest::GreaterEqual时通过测试的像素写入深度，返回像素掩码
+//rowEdges为行首像素的边函数值，stepX[k][i]为第k条边在第i个像素处相对行首的增量
+//输出通过像素的重心坐标lambda1、lambda2（边函数交换后的顶点顺序）与深度
+template<DepthTest depthTest>
+uint32_t CoverRow8(const int32_t *rowEdges, const int32_t (*stepX)[8], float invArea, const float *rhw,
+                   float *depthRow, uint32_t validMask, float *lambda1, float *lambda2, float *rowRhw)
+{
+#if defined(ENABLE_AVX2)
+    __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(rowEdges[0]), _mm256_load_si256((const __m256i *) stepX[0]));
+    __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(rowEdges[1]), _mm256_load_si256((const __m256i *) stepX[1]));
+    __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(rowEdges[2]), _mm256_load_si256((const __m256i *) stepX[2]));
+    //三个边函数的符号位都为0时在三角形内
+    __m256i sign = _mm256_or_si256(_mm256_or_si256(e0, e1), e2);
+    uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(sign))) & validMask;
+    if (mask == 0)
+    {
+        return 0;
+    }
+    __m256 l1 = _mm256_mul_ps(_mm256_cvtepi32_ps(e1), _mm256_set1_ps(invArea));
+    __m256 l2 = _mm256_mul_ps(_mm256_cvtepi32_ps(e2), _mm256_set1_ps(invArea));
+    __m256 z = _mm256_add_ps(_mm256_set1_ps(rhw[0]),
+                             _mm256_add_ps(_mm256_mul_ps(l1, _mm256_set1_ps(rhw[1] - rhw[0])),
+                                           _mm256_mul_ps(l2, _mm256_set1_ps(rhw[2] - rhw[0]))));
+    __m256 depth = _mm256_load_ps(depthRow);
+    constexpr int predicate = depthTest == DepthTest::Equal ? _CMP_EQ_OQ : _CMP_GE_OQ;
+    mask &= static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(z, depth, predicate)));
+    if (mask == 0)
+    {
+        return 0;
+    }
+    if constexpr (depthTest == DepthTest::GreaterEqual)
+    {
+        __m256i laneBits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        __m256 writeMask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+                _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)), laneBits), laneBits));
+        _mm256_store_ps(depthRow, _mm256_blendv_ps(depth, z, writeMask));
+    }
+    _mm256_storeu_ps(lambda1, l1);
+    _mm256_storeu_ps(lambda2, l2);
+    _mm256_storeu_ps(rowRhw, z);
+    return mask;
+#elif defined(ENABLE_SSE)
+    //分两次处理4个像素
+    uint32_t mask = 0;
+    for (int half = 0; half < 8; half += 4)
+    {
+        __m128i e0 = _mm_add_epi32(_mm_set1_epi32(rowEdges[0]), _mm_load_si128((const __m128i *) (stepX[0] + half)));
+        __m128i e1 = _mm_add_epi32(_mm_set1_epi32(rowEdges[1]), _mm_load_si128((const __m128i *) (stepX[1] + half)));
+        __m128i e2 = _mm_add_epi32(_mm_set1_epi32(rowEdges[2]), _mm_load_si128((const __m128i *) (stepX[2] + half)));
+        __m128i sign = _mm_or_si128(_mm_or_si128(e0, e1), e2);
+        uint32_t halfMask = ~static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(sign))) &
+                            (validMask >> half) & 0xFu;
+        if (halfMask == 0)
+        {
+            continue;
+        }
+        __m128 l1 = _mm_mul_ps(_mm_cvtepi32_ps(e1), _mm_set1_ps(invArea));
+        __m128 l2 = _mm_mul_ps(_mm_cvtepi32_ps(e2), _mm_set1_ps(invArea));
+        __m128 z = _mm_add_ps(_mm_set1_ps(rhw[0]), _mm_add_ps(_mm_mul_ps(l1, _mm_set1_ps(rhw[1] - rhw[0])),
+                                                              _mm_mul_ps(l2, _mm_set1_ps(rhw[2] - rhw[0]))));
+        __m128 depth = _mm_load_ps(depthRow + half);
+        __m128 pass = depthTest == DepthTest::Equal ? _mm_cmpeq_ps(z, depth) : _mm_cmpge_ps(z, depth);
+        halfMask &= static_cast<uint32_t>(_mm_movemask_ps(pass));
+        if (halfMask == 0)
+        {
+            continue;
+        }
+        if constexpr (depthTest == DepthTest::GreaterEqual)
+        {
+            __m128i laneBits = _mm_setr_epi32(1, 2, 4, 8);
+            __m128 writeMask = _mm_castsi128_ps(_mm_cmpeq_epi32(
+                    _mm_and_si128(_mm_set1_epi32(static_cast<int>(halfMask)), laneBits), laneBits));
+            _mm_store_ps(depthRow + half, _mm_or_ps(_mm_and_ps(writeMask, z), _mm_andnot_ps(writeMask, depth)));
+        }
+        _mm_storeu_ps(lambda1 + half, l1);
+        _mm_storeu_ps(lambda2 + half, l2);
+        _mm_storeu_ps(rowRhw + half, z);
+        mask |= halfMask << half;
+    }
+    return mask;
+#else
+    uint32_t mask = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        int32_t e0 = rowEdges[0] + stepX[0][i];
+        int32_t e1 = rowEdges[1] + stepX[1][i];
+        int32_t e2 = rowEdges[2] + stepX[2][i];
+        if (!(validMask & (1u << i)) || (e0 | e1 | e2) < 0)
+        {
+            continue;
+        }
+        float l1 = static_cast<float>(e1) * invArea;
+        float l2 = static_cast<float>(e2) * invArea;
+        float z = rhw[0] + l1 * (rhw[1] - rhw[0]) + l2 * (rhw[2] - rhw[0]);
+        if (depthTest == DepthTest::Equal ? z != depthRow[i] : z < depthRow[i])
+        {
+            continue;
+        }
+        if constexpr (depthTest == DepthTest::GreaterEqual)
+        {
+            depthRow[i] = z;
+        }
+        lambda1[i] = l1;
+        lambda2[i] = l2;
+        rowRhw[i] = z;
+        mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+//边函数光栅化：按8x8像素块遍历三角形在分块内的范围，跳过被Hi-Z遮挡或不与三角形相交的块
+//每块逐行计算8个像素的覆盖与深度，shade(index, alpha, beta, gamma, rhw)为通过深度测试的像素着色
+//重心坐标按三角形原顶点顺序给出，尚未做透视校正
+template<DepthTest depthTest = DepthTest::GreaterEqual, typename ShadeFunc>
+void RasterizeTriangle(const RasterTriangle &triangle, RasterTile &tile, HiZBuffer &hiZ, ShadeFunc &&shade)
+{
+    constexpr int kBlockSize = HiZBuffer::kTileSize;
+    const auto &edges = triangle.edges;
+    //三角形在当前分块内的范围，分块边长是像素块的整数倍
+    Bounds2i rect = triangle.rect;
+    rect.Clamp(tile.rect);
+    //交换顶点后的深度，与边函数的顶点顺序一致
+    const auto *vertices = triangle.vertices;
+    float rhw[3] = {vertices[0].rhw, vertices[1].rhw, vertices[2].rhw};
+    if (edges.isSwapped)
+    {
+        std::swap(rhw[1], rhw[2]);
+    }
+    alignas(32) int32_t stepX[3][8];
+    int32_t maxStep[3];
+    for (int k = 0; k < 3; ++k)
+    {
+        for (int i = 0; i < 8; ++i)
+        {
+            stepX[k][i] = edges.a[k] * i;
+        }
+        //像素块内相对左上角的最大增量，用于判断块是否与三角形相交
+        maxStep[k] = std::max(edges.a[k], 0) * (kBlockSize - 1) + std::max(edges.b[k], 0) * (kBlockSize - 1);
+    }
+    float lambda1[8], lambda2[8], rowRhw[8];
+    bool isWritten = false;
+    for (int blockY = rect.pMin.y / kBlockSize * kBlockSize; blockY <= rect.pMax.y; blockY += kBlockSize)
+    {
+        for (int blockX = rect.pMin.x / kBlockSize * kBlockSize; blockX <= rect.pMax.x; blockX += kBlockSize)
+        {
+            OCCLUSION_STATS_ADD(hiZ.stats, tilesTested, 1);
+            if (triangle.nearestRhw < hiZ.TileDepth(blockX / kBlockSize, blockY / kBlockSize))
+            {
+                OCCLUSION_STATS_ADD(hiZ.stats, tilesCulled, 1);
+                continue;
+            }
+            int32_t blockEdges[3];
+            bool isOutside = false;
+            for (int k = 0; k < 3; ++k)
+            {
+                blockEdges[k] = edges.Evaluate(k, blockX, blockY);
+                isOutside |= blockEdges[k] + maxStep[k] < 0;
+            }
+            if (isOutside)
+            {
+                continue;
+            }
+            //块内位于矩形范围的列
+            int xBegin = std::max(rect.pMin.x, blockX) - blockX;
+            int xEnd = std::min(rect.pMax.x, blockX + kBlockSize - 1) - blockX;
+            uint32_t validMask = ((1u << (xEnd + 1)) - 1) & ~((1u << xBegin) - 1);
+            int yEnd = std::min(rect.pMax.y, blockY + kBlockSize - 1);
+            for (int y = std::max(rect.pMin.y, blockY); y <= yEnd; ++y)
+            {
+                int32_t rowEdges[3];
+                for (int k = 0; k < 3; ++k)
+                {
+                    rowEdges[k] = blockEdges[k] + edges.b[k] * (y - blockY);
+                }
+                int index = tile.Index(blockX, y);
+                uint32_t mask = CoverRow8<depthTest>(rowEdges, stepX, edges.invArea, rhw, tile.depthBuffer + index,
+                                                     validMask, lambda1, lambda2, rowRhw);
+                isWritten |= depthTest == DepthTest::GreaterEqual && mask != 0;
+                for (; mask != 0; mask &= mask - 1)
+                {
+                    int i = __builtin_ctz(mask);
+                    float beta = lambda1[i], gamma = lambda2[i];
+                    if (edges.isSwapped)
+                    {
+                        std::swap(beta, gamma);
+                    }
+                    shade(index + i, 1.0f - lambda1[i] - lambda2[i], beta, gamma, rowRhw[i]);
+                }
+            }
+        }
+    }
+    //写入过深度的块在下一批绘制前更新
+    if (isWritten)
+    {
+        hiZ.MarkDirty(rect);
+    }
+}
\ No newline at end of file
@@ -3,6 +3,10 @@
 #include "Just/Common.h"
 #include "Just/Core/Scene.h"
 #include "Just/Core/RenderContext.h"
+#include "Just/Core/RasterTile.h"
+#include "Just/Core/VertexCache.h"
+#include "Just/Core/Clipper.h"
+#include "Just/Core/Shader.h"
 #include "Sampler.h"
 
 struct Renderer
@@ -24,10 +28,393 @@ public:
             : Renderer(scene, context) {};
     virtual ~Rasterizer() = default;
     virtual void Render() = 0;
+protected:
+    //每批绘制的三角形数量，批次之间更新Hi-Z
+    static constexpr size_t kOcclusionBatchSize = 512;
+    //前向渲染：由近到远绘制视锥内未被遮挡的三角形，shader.Vertex读取顶点属性，通过深度测试的像素立即由shader.Fragment着色
+    //isDepthPrepass时先只绘制深度，着色阶段只有与最终深度相等的片元着色，每个像素基本只着色一次
+    template<typename Shader>
+    void DrawVisibleFaces(const Shader &shader, bool isDepthPrepass = false);
+    //深度预渲染：只写入深度缓冲与Hi-Z，不读取顶点属性，也不着色
+    void DrawDepthPrepass(const Matrix4f &MVP);
+    //延迟渲染：先把可见表面光栅化到帧缓冲的G-buffer，再并行对每个被覆盖的像素调用一次shader.Shade
+    //着色次数只与分辨率有关，与深度复杂度无关
+    template<typename Shader>
+    void DrawDeferred(const Shader &shader);
+    //深度缓冲中被覆盖的像素数量，用于统计过度绘制
+    uint64_t CountCoveredPixels() const;
+    //读取G-buffer需要的全部顶点属性，网格没有法线时使用面法线
+    static void FetchSurface(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle);
+    //包围盒投影到屏幕后是否被Hi-Z完全遮挡，包围盒跨越近平面时不剔除
+    bool IsBoundsOccluded(const Bounds3f &bounds, const Matrix4f &MVP) const;
+    //三角形建立：顶点已有裁剪空间坐标、1/w与屏幕坐标，背面剔除与Hi-Z剔除，返回三角形是否需要光栅化
+    bool SetupTriangle(RasterTriangle &triangle) const;
+    //跨越近平面、远平面或保护带的三角形在齐次空间裁剪，裁剪后的多边形分成三角形，通过三角形建立的追加到output
+    void ClipAndSetupTriangle(const RasterTriangle &triangle, uint8_t clipCodes, float guardBand,
+                              std::vector<RasterTriangle> &output) const;
+protected:
+    //几何阶段后三角形的状态
+    enum class FaceState : uint8_t
+    {
+        Culled,
+        Visible,
+        //需要裁剪，在分块时串行处理
+        Clipped
+    };
+    //顶点阶段的结果，跨帧复用内存
+    VertexCache vertexCache;
 private:
-    virtual void DrawTriangle(RasterVertex *triangle) = 0;
+    //前向与延迟渲染共用的流程，fetchFace(mesh, faceIndex, vertices)读取通过几何阶段的三角形的顶点属性
+    //writeFragment(tile, triangle, index, alpha, beta, gamma)写入通过深度测试的像素，重心坐标已透视校正
+    //每批先变换新出现网格的顶点，再并行完成几何阶段并按提交顺序分块，最后每个分块由一个线程光栅化，结果与线程数无关
+    template<DepthTest depthTest = DepthTest::GreaterEqual, typename FetchFunc, typename WriteFunc>
+    void DrawFaces(const Matrix4f &MVP, FetchFunc &&fetchFace, WriteFunc &&writeFragment);
 };
 
+template<typename Shader>
+void Rasterizer::DrawVisibleFaces(const Shader &shader, bool isDepthPrepass)
+{
+    auto fetchFace = [&shader](const Mesh &mesh, size_t faceIndex, RasterVertex *triangle) {
+        shader.Vertex(mesh, faceIndex, triangle);
+    };
+    auto writeFragment = [&shader](RasterTile &tile, const RasterTriangle &triangle, int index,
+                                   float alpha, float beta, float gamma) {
+        //片元着色
+        tile.colorBuffer[index] = shader.Fragment(triangle.vertices, alpha, beta, gamma);
+        ++tile.shadedCount;
+    };
+    if (isDepthPrepass)
+    {
+        DrawDepthPrepass(shader.uniforms.MVP);
+        //深度缓冲已是最终结果，被遮挡的片元不再着色
+        DrawFaces<DepthTest::Equal>(shader.uniforms.MVP, fetchFace, writeFragment);
+    }
+    else
+    {
+        DrawFaces(shader.uniforms.MVP, fetchFace, writeFragment);
+    }
+#ifdef ENABLE_ACCEL_STATS
+    context->frameBuffer->hiZ.stats.pixelsCovered.store(CountCoveredPixels(), std::memory_order_relaxed);
+#endif
+}
+template<typename Shader>
+void Rasterizer::DrawDeferred(const Shader &shader)
+{
+    auto &frameBuffer = context->frameBuffer;
+    auto &gBuffer = frameBuffer->gBuffer;
+    if (gBuffer.IsEmpty())
+    {
+        gBuffer.Resize(frameBuffer->res);
+    }
+    //几何阶段：只写入深度与表面数据，被覆盖的像素不着色
+    DrawFaces(shader.uniforms.MVP, FetchSurface,
+              [&gBuffer, width = frameBuffer->res.x](RasterTile &tile, const RasterTriangle &triangle, int index,
+                                                     float alpha, float beta, float gamma) {
+                  Point2i pixel = tile.Pixel(index);
+                  auto &sample = gBuffer.samples[pixel.x + pixel.y * width];
+                  sample = InterpolateSurface(triangle.vertices, alpha, beta, gamma);
+                  sample.meshIndex = triangle.meshIndex;
+                  sample.faceIndex = triangle.faceIndex;
+              });
+    //着色阶段：每个像素只着色一次
+    int pixelCount = frameBuffer->res.x * frameBuffer->res.y;
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        const auto &sample = gBuffer.samples[i];
+        if (sample.IsValid())
+        {
+            frameBuffer->colorBuffer[i] = shader.Shade(sample);
+        }
+    }
+#ifdef ENABLE_ACCEL_STATS
+    //每个被覆盖的像素着色一次
+    auto coveredCount = CountCoveredPixels();
+    frameBuffer->hiZ.stats.pixelsCovered.store(coveredCount, std::memory_order_relaxed);
+    frameBuffer->hiZ.stats.fragmentsShaded.fetch_add(coveredCount, std::memory_order_relaxed);
+#endif
+}
+template<DepthTest depthTest, typename FetchFunc, typename WriteFunc>
+void Rasterizer::DrawFaces(const Matrix4f &MVP, FetchFunc &&fetchFace, WriteFunc &&writeFragment)
+{
+    auto &frameBuffer = context->frameBuffer;
+    const auto &meshes = scene->accel->meshes;
+    Frustum frustum(MVP);
+    float guardBand = GuardBand(context->camera->screenToRaster, EdgeFunctions::SubPixelBits(frameBuffer->res));
+    vertexCache.Reset(meshes.size());
+    Point2i binCount{(frameBuffer->res.x + RasterTile::kSize - 1) / RasterTile::kSize,
+                     (frameBuffer->res.y + RasterTile::kSize - 1) / RasterTile::kSize};
+    std::vector<std::pair<size_t, size_t>> batch;
+    batch.reserve(kOcclusionBatchSize);
+    std::vector<RasterTriangle> triangles;
+    std::vector<FaceState> faceStates;
+    std::vector<uint8_t> clipCodes;
+    //裁剪产生的三角形，分块中的索引接在triangles之后
+    std::vector<RasterTriangle> clippedTriangles;
+    //每个分块中按提交顺序排列的三角形索引
+    std::vector<std::vector<uint32_t>> bins(binCount.x * binCount.y);
+    std::vector<int> activeBins;
+    auto flush = [&]() {
+        //顶点阶段，每个顶点每帧只变换一次
+        vertexCache.Prepare(meshes, batch.data(), batch.size(), MVP, context->camera->screenToRaster, guardBand);
+        triangles.resize(batch.size());
+        faceStates.resize(batch.size());
+        clipCodes.resize(batch.size());
+#ifdef ENABLE_OPENMP
+        //OpenMP多线程渲染
+#pragma omp parallel for schedule(static)
+#endif
+        for (int i = 0; i < static_cast<int>(batch.size()); ++i)
+        {
+            const auto &[meshIndex, faceIndex] = batch[i];
+            const auto &mesh = *meshes[meshIndex];
+            const auto &clipVertices = vertexCache[meshIndex];
+            const size_t *indices = &mesh.indices[3 * faceIndex];
+            auto &triangle = triangles[i];
+            triangle.meshIndex = static_cast<uint32_t>(meshIndex);
+            triangle.faceIndex = static_cast<uint32_t>(faceIndex);
+            uint8_t code0 = clipVertices.outcodes[indices[0]];
+            uint8_t code1 = clipVertices.outcodes[indices[1]];
+            uint8_t code2 = clipVertices.outcodes[indices[2]];
+            for (int j = 0; j < 3; ++j)
+            {
+                clipVertices.Load(indices[j], triangle.vertices[j]);
+            }
+            //三个顶点都在同一个面外侧时剔除，都在近平面、远平面与保护带内时不必裁剪
+            clipCodes[i] = static_cast<uint8_t>(code0 | code1 | code2);
+            if (code0 & code1 & code2 & ClipVertices::kOutsideView)
+            {
+                faceStates[i] = FaceState::Culled;
+            }
+            else if (clipCodes[i] & ClipVertices::kNeedsClipping)
+            {
+                faceStates[i] = FaceState::Clipped;
+            }
+            else
+            {
+                faceStates[i] = SetupTriangle(triangle) ? FaceState::Visible : FaceState::Culled;
+            }
+            if (faceStates[i] != FaceState::Culled)
+            {
+                fetchFace(mesh, faceIndex, triangle.vertices);
+            }
+        }
+        //分块，三角形在每个分块内保持提交顺序
+        activeBins.clear();
+        clippedTriangles.clear();
+        auto addToBins = [&](const Bounds2i &rect, uint32_t index) {
+            for (int binY = rect.pMin.y / RasterTile::kSize; binY <= rect.pMax.y / RasterTile::kSize; ++binY)
+            {
+                for (int binX = rect.pMin.x / RasterTile::kSize; binX <= rect.pMax.x / RasterTile::kSize; ++binX)
+                {
+                    int bin = binX + binY * binCount.x;
+                    if (bins[bin].empty())
+                    {
+                        activeBins.push_back(bin);
+                    }
+                    bins[bin].push_back(index);
+                }
+            }
+        };
+        for (size_t i = 0; i < triangles.size(); ++i)
+        {
+            if (faceStates[i] == FaceState::Visible)
+            {
+                addToBins(triangles[i].rect, static_cast<uint32_t>(i));
+            }
+            else if (faceStates[i] == FaceState::Clipped)
+            {
+                size_t first = clippedTriangles.size();
+                ClipAndSetupTriangle(triangles[i], clipCodes[i], guardBand, clippedTriangles);
+                for (size_t k = first; k < clippedTriangles.size(); ++k)
+                {
+                    addToBins(clippedTriangles[k].rect, static_cast<uint32_t>(triangles.size() + k));
+                }
+            }
+        }
+        //每个分块由一个线程光栅化，分块之间没有共享写入
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+        for (int k = 0; k < static_cast<int>(activeBins.size()); ++k)
+        {
+            int bin = activeBins[k];
+            int binX = bin % binCount.x, binY = bin / binCount.x;
+            Bounds2i binRect(binX * RasterTile::kSize, binY * RasterTile::kSize,
+                             binX * RasterTile::kSize + RasterTile::kSize - 1,
+                             binY * RasterTile::kSize + RasterTile::kSize - 1);
+            binRect.Clamp(frameBuffer->screenRect);
+            RasterTile tile(binRect);
+            tile.Load(*frameBuffer);
+            for (auto i: bins[bin])
+            {
+                const auto &triangle = i < triangles.size() ? triangles[i] : clippedTriangles[i - triangles.size()];
+                const auto *vertices = triangle.vertices;
+                //光栅化阶段
+                RasterizeTriangle<depthTest>(triangle, tile, frameBuffer->hiZ,
+                                             [&](int index, float alpha, float beta, float gamma, float rhw) {
+                    //透视插值校正
+                    float w = 1.0f / ((rhw == 0.0f) ? 1.0f : rhw);
+                    alpha = alpha * w * vertices[0].rhw;
+                    beta = beta * w * vertices[1].rhw;
+                    gamma = gamma * w * vertices[2].rhw;
+                    writeFragment(tile, triangle, index, alpha, beta, gamma);
+                });
+            }
+            tile.Store(*frameBuffer);
+            OCCLUSION_STATS_ADD(frameBuffer->hiZ.stats, fragmentsShaded, tile.shadedCount);
+            bins[bin].clear();
+        }
+        batch.clear();
+        frameBuffer->hiZ.Update(frameBuffer->depthBuffer);
+    };
+    scene->accel->OcclusionCulling(
+            frustum,
+            [&](const Bounds3f &bounds) { return IsBoundsOccluded(bounds, MVP); },
+            [&](const std::pair<size_t, size_t> *faces, size_t count) {
+                batch.insert(batch.end(), faces, faces + count);
+                if (batch.size() >= kOcclusionBatchSize)
+                {
+                    flush();
+                }
+            });
+    flush();
+}
+inline void Rasterizer::DrawDepthPrepass(const Matrix4f &MVP)
+{
+    DrawFaces(MVP,
+              [](const Mesh &, size_t, RasterVertex *) {},
+              [](RasterTile &, const RasterTriangle &, int, float, float, float) {});
+}
+inline uint64_t Rasterizer::CountCoveredPixels() const
+{
+    const auto &frameBuffer = context->frameBuffer;
+    int pixelCount = frameBuffer->res.x * frameBuffer->res.y;
+    uint64_t count = 0;
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static) reduction(+:count)
+#endif
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        count += frameBuffer->depthBuffer[i] > 0.0f ? 1 : 0;
+    }
+    return count;
+}
+inline void Rasterizer::FetchSurface(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle)
+{
+    auto i = 3 * faceIndex;
+    for (int j = 0; j < 3; j++)
+    {
+        auto index = mesh.indices[i + j];
+        triangle[j].pos = mesh.positions[index];
+        triangle[j].texcoord = mesh.texcoords.empty() ? Point2f(0, 0) : mesh.texcoords[index];
+    }
+    auto faceNormal = Normalize(Cross((triangle[1].pos - triangle[0].pos), (triangle[2].pos - triangle[0].pos)));
+    for (int j = 0; j < 3; j++)
+    {
+        triangle[j].normal = mesh.normals.empty() ? faceNormal : mesh.normals[mesh.indices[i + j]];
+    }
+}
+inline bool Rasterizer::IsBoundsOccluded(const Bounds3f &bounds, const Matrix4f &MVP) const
+{
+    auto &hiZ = context->frameBuffer->hiZ;
+    Bounds2f rect;
+    float rhw = 0.0f;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        auto pos4 = MVP * Point4f(bounds.Corner(corner), 1.0f);
+        if (pos4.z < 0.0f || pos4.w <= 0.0f)
+        {
+            return false;
+        }
+        float cornerRhw = 1.0f / pos4.w;
+        rhw = std::max(rhw, cornerRhw);
+        rect.Expand(Point2f{context->camera->screenToRaster(pos4 * cornerRhw)});
+    }
+    Bounds2i pixels(static_cast<int>(std::floor(rect.pMin.x)), static_cast<int>(std::floor(rect.pMin.y)),
+                    static_cast<int>(std::ceil(rect.pMax.x)), static_cast<int>(std::ceil(rect.pMax.y)));
+    pixels.Clamp(context->frameBuffer->screenRect);
+    OCCLUSION_STATS_ADD(hiZ.stats, nodesTested, 1);
+    if (!hiZ.IsOccluded(pixels, rhw))
+    {
+        return false;
+    }
+    OCCLUSION_STATS_ADD(hiZ.stats, nodesCulled, 1);
+    return true;
+}
+inline bool Rasterizer::SetupTriangle(RasterTriangle &triangle) const
+{
+    auto &vertices = triangle.vertices;
+    Bounds2i rect;
+    for (int i = 0; i < 3; ++i)
+    {
+        auto &vertex = vertices[i];
+        //四舍五入
+        vertex.pos2i = Point2i{(int) (vertex.pos2f.x + 0.5f), (int) (vertex.pos2f.y + 0.5f)};
+        //设置三角形矩形范围
+        rect.Expand(vertex.pos2i);
+    }
+    //限制在屏幕范围内
+    rect.Clamp(context->frameBuffer->screenRect);
+    //建立定点边函数，吸附到子像素后退化的三角形不覆盖任何像素
+    if (!triangle.edges.Setup(vertices, EdgeFunctions::SubPixelBits(context->frameBuffer->res)))
+    {
+        return false;
+    }
+    //背面剔除，屏幕映射同时翻转x与y，环绕方向不变，正面三角形在屏幕上的有向面积为负
+    if (!triangle.edges.isSwapped)
+    {
+        return false;
+    }
+    //Hi-Z剔除，三角形最近的深度在所覆盖区域的最远深度之后时整体跳过
+    auto &hiZ = context->frameBuffer->hiZ;
+    triangle.rect = rect;
+    triangle.nearestRhw = std::max({vertices[0].rhw, vertices[1].rhw, vertices[2].rhw});
+    OCCLUSION_STATS_ADD(hiZ.stats, trianglesTested, 1);
+    if (hiZ.IsOccluded(rect, triangle.nearestRhw))
+    {
+        OCCLUSION_STATS_ADD(hiZ.stats, trianglesCulled, 1);
+        return false;
+    }
+    return true;
+}
+inline void Rasterizer::ClipAndSetupTriangle(const RasterTriangle &triangle, uint8_t clipCodes, float guardBand,
+                                             std::vector<RasterTriangle> &output) const
+{
+    const auto *vertices = triangle.vertices;
+    Point4f positions[3] = {vertices[0].pos4, vertices[1].pos4, vertices[2].pos4};
+    ClipVertex polygon[kMaxClipVertices];
+    int count = ClipTriangle(positions, clipCodes, guardBand, polygon);
+    //裁剪空间中线性插值顶点属性，透视除法之后仍是透视正确的
+    auto makeVertex = [&](const ClipVertex &clipVertex, RasterVertex &vertex) {
+        const auto &weights = clipVertex.weights;
+        vertex.pos = weights.x * vertices[0].pos + weights.y * vertices[1].pos + weights.z * vertices[2].pos;
+        vertex.texcoord = weights.x * vertices[0].texcoord + weights.y * vertices[1].texcoord +
+                          weights.z * vertices[2].texcoord;
+        vertex.normal = weights.x * vertices[0].normal + weights.y * vertices[1].normal +
+                        weights.z * vertices[2].normal;
+        vertex.pos4 = clipVertex.pos;
+        vertex.rhw = 1.0f / clipVertex.pos.w;
+        vertex.pos2f = Point2f{context->camera->screenToRaster(clipVertex.pos * vertex.rhw)};
+    };
+    //以第一个顶点为中心分成三角形
+    for (int i = 1; i + 1 < count; ++i)
+    {
+        RasterTriangle piece;
+        piece.meshIndex = triangle.meshIndex;
+        piece.faceIndex = triangle.faceIndex;
+        makeVertex(polygon[0], piece.vertices[0]);
+        makeVertex(polygon[i], piece.vertices[1]);
+        makeVertex(polygon[i + 1], piece.vertices[2]);
+        if (SetupTriangle(piece))
+        {
+            output.push_back(piece);
+        }
+    }
+}
+
 struct Tracer : virtual public Renderer
 {
 public:
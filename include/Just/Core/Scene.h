@@ -5,20 +5,68 @@
 #include "Just/Core/Accel.h"
 #include "Just/Accel/NaiveAccel.h"
 #include "Just/Accel/BVHAccel.h"
+#include "Just/Accel/OctTreeAccel.h"
+#include "Just/Accel/LBVHAccel.h"
+#include "Just/Accel/InstanceAccel.h"
+#include "Just/Accel/WideBVHAccel.h"
+#include "Just/Accel/SBVHAccel.h"
+#include "Just/Accel/CompressedBVHAccel.h"
+
+//根据类型创建加速结构
+inline std::shared_ptr<Accel> CreateAccel(AccelType type)
+{
+    switch (type)
+    {
+        case AccelType::NaiveAccel:
+            return std::make_shared<NaiveAccel>();
+        case AccelType::OctreeAccel:
+            return std::make_shared<OctTreeAccel>();
+        case AccelType::LBVHAccel:
+            return std::make_shared<LBVHAccel>();
+        case AccelType::InstanceAccel:
+            return std::make_shared<InstanceAccel>();
+        case AccelType::WideBVHAccel:
+            return std::make_shared<WideBVHAccel>();
+        case AccelType::SBVHAccel:
+            return std::make_shared<SBVHAccel>();
+        case AccelType::CompressedBVHAccel:
+            return std::make_shared<CompressedBVHAccel>();
+        case AccelType::BVHAccel:
+        default:
+            return std::make_shared<BVHAccel>();
+    }
+}
 
 struct Scene
 {
 public:
     explicit Scene(const std::shared_ptr<Accel> &accel) : accel(accel) {};
+    explicit Scene(AccelType type) : accel(CreateAccel(type)) {};
     void BuildAccel();
+    //优先从缓存目录读取加速结构，未命中时构建并写入缓存
+    void BuildAccel(const std::string &cacheDirectory);
+    void RefitAccel(size_t meshIndex);
     void AddMesh(const std::shared_ptr<Mesh> &mesh);
     bool RayIntersect(const Ray &ray, HitRecord &record) const;
     bool RayIntersect(const Ray &ray) const;
+    //遮挡查询，tMax通常为到光源的距离
+    bool Occluded(const Ray &ray, float tMax) const;
+    //相邻相机射线组成射线包求交，返回击中射线的位掩码
+    uint32_t RayIntersectPacket8(const Ray *rays, HitRecord *records, int count = 8) const;
+    //射线流求交，按方向卦限与起点位置排序后相邻射线组成射线包，适合漫反射等不相干的次级射线
+    //结果按输入顺序写入records，未击中射线的hitMesh为空，返回击中数量
+    size_t RayIntersectStream(const Ray *rays, HitRecord *records, size_t count) const;
+    //收集加速结构统计并合并各线程的遍历计数，在渲染结束后调用
+    void MergeStats();
+    //以JSON格式写入统计结果
+    bool SaveStats(const std::string &path) const;
     ~Scene() = default;
 public:
     std::vector<std::shared_ptr<Mesh>> meshes;
     std::vector<Ref<Mesh>> emitters;
     std::shared_ptr<Accel> accel;
+    //多次渲染的遍历计数累加
+    AccelStats stats;
 };
 
 
@@ -39,12 +87,113 @@ void Scene::BuildAccel()
     }
     accel->Build();
 }
+void Scene::BuildAccel(const std::string &cacheDirectory)
+{
+    accel->Reset();
+    for (const auto &mesh: meshes)
+    {
+        accel->AddMesh(mesh);
+    }
+    //键包含网格数据与构建参数，任一变化都会生成新的缓存文件
+    auto path = CachePath(cacheDirectory, accel->ContentHash(), ".accel");
+    if (accel->LoadCache(path))
+    {
+        std::cout << "[info]: load accel from cache " << path << "\n";
+        return;
+    }
+    accel->Build();
+    if (accel->SaveCache(path))
+    {
+        std::cout << "[info]: save accel to cache " << path << "\n";
+    }
+}
+//网格顶点变化但拓扑不变时，只更新加速结构包围盒
+void Scene::RefitAccel(size_t meshIndex)
+{
+    accel->Refit(meshIndex);
+}
 bool Scene::RayIntersect(const Ray &ray, HitRecord &record) const
 {
+    ACCEL_STATS_ADD(rayCount, 1);
     return accel->RayIntersect(ray, record, false);
 }
 bool Scene::RayIntersect(const Ray &ray) const
 {
-    HitRecord record;
-    return accel->RayIntersect(ray, record, true);
+    ACCEL_STATS_ADD(rayCount, 1);
+    return accel->Occluded(ray, ray.tMax);
+}
+bool Scene::Occluded(const Ray &ray, float tMax) const
+{
+    ACCEL_STATS_ADD(rayCount, 1);
+    return accel->Occluded(ray, tMax);
+}
+uint32_t Scene::RayIntersectPacket8(const Ray *rays, HitRecord *records, int count) const
+{
+    ACCEL_STATS_ADD(rayCount, count);
+    return accel->RayIntersectPacket8(rays, records, count);
+}
+size_t Scene::RayIntersectStream(const Ray *rays, HitRecord *records, size_t count) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    ACCEL_STATS_ADD(rayCount, count);
+    //排序键：方向卦限占最高3位，其后为起点在场景包围盒内的27位莫顿码
+    Vector3f diagonal = accel->bounds.Diagonal();
+    Vector3f invDiagonal(diagonal.x > 0.0f ? 1.0f / diagonal.x : 0.0f,
+                         diagonal.y > 0.0f ? 1.0f / diagonal.y : 0.0f,
+                         diagonal.z > 0.0f ? 1.0f / diagonal.z : 0.0f);
+    std::vector<MortonPrimitive> order(count);
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int i = 0; i < static_cast<int>(count); ++i)
+    {
+        const auto &ray = rays[i];
+        uint32_t octant = (static_cast<uint32_t>(ray.direction.x < 0.0f) << 2) |
+                          (static_cast<uint32_t>(ray.direction.y < 0.0f) << 1) |
+                          static_cast<uint32_t>(ray.direction.z < 0.0f);
+        uint32_t cell = EncodeMorton3((ray.origin - accel->bounds.pMin) * invDiagonal) >> 3;
+        order[i] = {(octant << 27) | cell, static_cast<uint32_t>(i)};
+    }
+    LBVHAccel::RadixSort(order);
+    //排序后相邻的8条射线组成射线包，结果写回原位置
+    auto groupCount = static_cast<int>((count + RayPacket8::kSize - 1) / RayPacket8::kSize);
+    size_t hitCount = 0;
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic, 64) reduction(+:hitCount)
+#endif
+    for (int group = 0; group < groupCount; ++group)
+    {
+        size_t begin = static_cast<size_t>(group) * RayPacket8::kSize;
+        int packetSize = static_cast<int>(std::min<size_t>(RayPacket8::kSize, count - begin));
+        Ray packet[RayPacket8::kSize];
+        HitRecord packetRecords[RayPacket8::kSize];
+        for (int i = 0; i < packetSize; ++i)
+        {
+            packet[i] = rays[order[begin + i].index];
+        }
+        uint32_t mask = accel->RayIntersectPacket8(packet, packetRecords, packetSize);
+        for (int i = 0; i < packetSize; ++i)
+        {
+            bool isHit = (mask >> i) & 1u;
+            records[order[begin + i].index] = isHit ? packetRecords[i] : HitRecord();
+            hitCount += isHit;
+        }
+    }
+    return hitCount;
+}
+void Scene::MergeStats()
+{
+    auto traversal = stats.traversal;
+    traversal += TraversalCounterRegistry::GetInstance().Merge();
+    stats = accel->CollectStats();
+    stats.traversal = traversal;
+}
+bool Scene::SaveStats(const std::string &path) const
+{
+    std::ofstream stream(path);
+    stream << stats.ToJson();
+    return stream.good();
 }
\ No newline at end of file
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Core/RenderContext.h"
+
+//光栅化着色器作为模板参数传给Rasterizer::DrawVisibleFaces，逐像素路径在编译期确定，可以整体内联
+//着色器需要提供：
+//  ShaderUniforms uniforms;
+//  void Vertex(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle) const;
+//      读取三角形的顶点属性，顶点位置由顶点阶段按uniforms.MVP统一变换
+//  RGBA32 Fragment(const RasterVertex *triangle, float alpha, float beta, float gamma) const;
+//      由透视校正后的重心坐标计算像素颜色
+//着色器自己的常量（纹理等）在构造时绑定，绘制期间不再访问RenderContext
+
+//绘制期间不变的常量，绘制前从RenderContext按名字读取一次
+struct ShaderUniforms
+{
+    Matrix4f MVP;
+    static ShaderUniforms Bind(const RenderContext &context)
+    {
+        return {context.GetUniform<Matrix4f>("MVP")};
+    }
+};
\ No newline at end of file
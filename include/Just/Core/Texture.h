@@ -11,7 +11,7 @@ public:
     virtual ~Texture() = default;
 };
 
-struct ConstantTexture : public Texture
+struct ConstantTexture final : public Texture
 {
 public:
     explicit ConstantTexture(const Color3f &value) : value(value) {}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Math/Transform.h"
+#include "Just/Geometry/Mesh.h"
+#include "Just/Core/RasterVertex.h"
+
+//顶点阶段的输出，按分量分别存放，网格的每个顶点只变换一次
+struct ClipVertices
+{
+public:
+    //顶点在CVV外侧的面
+    static constexpr uint8_t kOutsideLeft = 1 << 0;
+    static constexpr uint8_t kOutsideRight = 1 << 1;
+    static constexpr uint8_t kOutsideBottom = 1 << 2;
+    static constexpr uint8_t kOutsideTop = 1 << 3;
+    static constexpr uint8_t kOutsideNear = 1 << 4;
+    static constexpr uint8_t kOutsideFar = 1 << 5;
+    //x或y超出保护带
+    static constexpr uint8_t kOutsideGuardX = 1 << 6;
+    static constexpr uint8_t kOutsideGuardY = 1 << 7;
+    //三个顶点都在同一个面外侧时三角形不可见
+    static constexpr uint8_t kOutsideView = kOutsideLeft | kOutsideRight | kOutsideBottom | kOutsideTop |
+                                            kOutsideNear | kOutsideFar;
+    //任一顶点在这些面外侧时三角形需要裁剪，只超出屏幕而在保护带内的三角形由光栅化的矩形范围处理
+    static constexpr uint8_t kNeedsClipping = kOutsideNear | kOutsideFar | kOutsideGuardX | kOutsideGuardY;
+    void Resize(size_t count);
+    //变换[begin, end)范围内的顶点：MVP变换、求1/w、透视除法、屏幕映射与CVV、保护带测试
+    void TransformRange(const Point3f *positions, size_t begin, size_t end,
+                        const Matrix4f &MVP, const Transform &screenToRaster, float guardBand);
+    //读取顶点的裁剪空间坐标、1/w与屏幕坐标
+    void Load(size_t index, RasterVertex &vertex) const
+    {
+        vertex.pos4 = Point4f{x[index], y[index], z[index], w[index]};
+        vertex.rhw = rhw[index];
+        vertex.pos2f = Point2f{rasterX[index], rasterY[index]};
+    }
+public:
+    //裁剪空间坐标
+    std::vector<float> x, y, z, w;
+    std::vector<float> rhw;
+    //屏幕坐标
+    std::vector<float> rasterX, rasterY;
+    std::vector<uint8_t> outcodes;
+};
+
+inline void ClipVertices::Resize(size_t count)
+{
+    for (auto *component: {&x, &y, &z, &w, &rhw, &rasterX, &rasterY})
+    {
+        component->resize(count);
+    }
+    outcodes.resize(count);
+}
+inline void ClipVertices::TransformRange(const Point3f *positions, size_t begin, size_t end,
+                                        const Matrix4f &MVP, const Transform &screenToRaster, float guardBand)
+{
+    size_t i = begin;
+    //加法顺序与Matrix4f * Point4f、Transform::operator()一致，结果与逐顶点变换相同
+#if defined(ENABLE_AVX2)
+    __m256 m[4][4], s[4][4];
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int col = 0; col < 4; ++col)
+        {
+            m[row][col] = _mm256_set1_ps(MVP[row][col]);
+            s[row][col] = _mm256_set1_ps(screenToRaster.matrix[row][col]);
+        }
+    }
+    //Point3f连续存放，每隔3个float读取一个分量
+    const __m256i offsets = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    for (; i + 8 <= end; i += 8)
+    {
+        const float *base = &positions[i].x;
+        __m256 p[3] = {_mm256_i32gather_ps(base, offsets, 4),
+                       _mm256_i32gather_ps(base + 1, offsets, 4),
+                       _mm256_i32gather_ps(base + 2, offsets, 4)};
+        __m256 clip[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            __m256 sum = _mm256_mul_ps(m[row][0], p[0]);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(m[row][1], p[1]));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(m[row][2], p[2]));
+            clip[row] = _mm256_add_ps(sum, m[row][3]);
+        }
+        __m256 rhwClip = _mm256_div_ps(_mm256_set1_ps(1.0f), clip[3]);
+        __m256 ndc[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            ndc[row] = _mm256_mul_ps(clip[row], rhwClip);
+        }
+        __m256 screen[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            __m256 sum = _mm256_mul_ps(s[row][0], ndc[0]);
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(s[row][1], ndc[1]));
+            sum = _mm256_add_ps(sum, _mm256_mul_ps(s[row][2], ndc[2]));
+            screen[row] = _mm256_add_ps(sum, _mm256_mul_ps(s[row][3], ndc[3]));
+        }
+        _mm256_storeu_ps(&x[i], clip[0]);
+        _mm256_storeu_ps(&y[i], clip[1]);
+        _mm256_storeu_ps(&z[i], clip[2]);
+        _mm256_storeu_ps(&w[i], clip[3]);
+        _mm256_storeu_ps(&rhw[i], rhwClip);
+        _mm256_storeu_ps(&rasterX[i], _mm256_div_ps(screen[0], screen[3]));
+        _mm256_storeu_ps(&rasterY[i], _mm256_div_ps(screen[1], screen[3]));
+        //CVV与保护带测试，各面的比较结果合并为每个顶点的标记
+        __m256 negW = _mm256_sub_ps(_mm256_setzero_ps(), clip[3]);
+        __m256 guardW = _mm256_mul_ps(_mm256_set1_ps(guardBand), clip[3]);
+        auto outside = [](__m256 mask, uint8_t bit) {
+            return _mm256_and_si256(_mm256_castps_si256(mask), _mm256_set1_epi32(bit));
+        };
+        auto outsideGuard = [&outside, guardW](__m256 value, uint8_t bit) {
+            __m256 absValue = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value);
+            return outside(_mm256_cmp_ps(absValue, guardW, _CMP_GT_OQ), bit);
+        };
+        __m256i codes = _mm256_or_si256(
+                _mm256_or_si256(outside(_mm256_cmp_ps(clip[0], negW, _CMP_LT_OQ), kOutsideLeft),
+                                outside(_mm256_cmp_ps(clip[0], clip[3], _CMP_GT_OQ), kOutsideRight)),
+                _mm256_or_si256(outside(_mm256_cmp_ps(clip[1], negW, _CMP_LT_OQ), kOutsideBottom),
+                                outside(_mm256_cmp_ps(clip[1], clip[3], _CMP_GT_OQ), kOutsideTop)));
+        codes = _mm256_or_si256(codes, _mm256_or_si256(
+                _mm256_or_si256(outside(_mm256_cmp_ps(clip[2], _mm256_setzero_ps(), _CMP_LT_OQ), kOutsideNear),
+                                outside(_mm256_cmp_ps(clip[2], clip[3], _CMP_GT_OQ), kOutsideFar)),
+                _mm256_or_si256(outsideGuard(clip[0], kOutsideGuardX), outsideGuard(clip[1], kOutsideGuardY))));
+        alignas(32) int32_t laneCodes[8];
+        _mm256_store_si256((__m256i *) laneCodes, codes);
+        for (int lane = 0; lane < 8; ++lane)
+        {
+            outcodes[i + lane] = static_cast<uint8_t>(laneCodes[lane]);
+        }
+    }
+#elif defined(ENABLE_SSE)
+    __m128 m[4][4], s[4][4];
+    for (int row = 0; row < 4; ++row)
+    {
+        for (int col = 0; col < 4; ++col)
+        {
+            m[row][col] = _mm_set1_ps(MVP[row][col]);
+            s[row][col] = _mm_set1_ps(screenToRaster.matrix[row][col]);
+        }
+    }
+    for (; i + 4 <= end; i += 4)
+    {
+        const Point3f *p4 = positions + i;
+        __m128 p[3] = {_mm_setr_ps(p4[0].x, p4[1].x, p4[2].x, p4[3].x),
+                       _mm_setr_ps(p4[0].y, p4[1].y, p4[2].y, p4[3].y),
+                       _mm_setr_ps(p4[0].z, p4[1].z, p4[2].z, p4[3].z)};
+        __m128 clip[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            __m128 sum = _mm_mul_ps(m[row][0], p[0]);
+            sum = _mm_add_ps(sum, _mm_mul_ps(m[row][1], p[1]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(m[row][2], p[2]));
+            clip[row] = _mm_add_ps(sum, m[row][3]);
+        }
+        __m128 rhwClip = _mm_div_ps(_mm_set1_ps(1.0f), clip[3]);
+        __m128 ndc[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            ndc[row] = _mm_mul_ps(clip[row], rhwClip);
+        }
+        __m128 screen[4];
+        for (int row = 0; row < 4; ++row)
+        {
+            __m128 sum = _mm_mul_ps(s[row][0], ndc[0]);
+            sum = _mm_add_ps(sum, _mm_mul_ps(s[row][1], ndc[1]));
+            sum = _mm_add_ps(sum, _mm_mul_ps(s[row][2], ndc[2]));
+            screen[row] = _mm_add_ps(sum, _mm_mul_ps(s[row][3], ndc[3]));
+        }
+        _mm_storeu_ps(&x[i], clip[0]);
+        _mm_storeu_ps(&y[i], clip[1]);
+        _mm_storeu_ps(&z[i], clip[2]);
+        _mm_storeu_ps(&w[i], clip[3]);
+        _mm_storeu_ps(&rhw[i], rhwClip);
+        _mm_storeu_ps(&rasterX[i], _mm_div_ps(screen[0], screen[3]));
+        _mm_storeu_ps(&rasterY[i], _mm_div_ps(screen[1], screen[3]));
+        //CVV与保护带测试，各面的比较结果合并为每个顶点的标记
+        __m128 negW = _mm_sub_ps(_mm_setzero_ps(), clip[3]);
+        __m128 guardW = _mm_mul_ps(_mm_set1_ps(guardBand), clip[3]);
+        __m128 signMask = _mm_set1_ps(-0.0f);
+        int masks[8] = {_mm_movemask_ps(_mm_cmplt_ps(clip[0], negW)),
+                        _mm_movemask_ps(_mm_cmpgt_ps(clip[0], clip[3])),
+                        _mm_movemask_ps(_mm_cmplt_ps(clip[1], negW)),
+                        _mm_movemask_ps(_mm_cmpgt_ps(clip[1], clip[3])),
+                        _mm_movemask_ps(_mm_cmplt_ps(clip[2], _mm_setzero_ps())),
+                        _mm_movemask_ps(_mm_cmpgt_ps(clip[2], clip[3])),
+                        _mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(signMask, clip[0]), guardW)),
+                        _mm_movemask_ps(_mm_cmpgt_ps(_mm_andnot_ps(signMask, clip[1]), guardW))};
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            uint8_t code = 0;
+            for (int plane = 0; plane < 8; ++plane)
+            {
+                code |= static_cast<uint8_t>(((masks[plane] >> lane) & 1) << plane);
+            }
+            outcodes[i + lane] = code;
+        }
+    }
+#endif
+    //剩余顶点逐个变换
+    for (; i < end; ++i)
+    {
+        auto clip = MVP * Point4f(positions[i], 1.0f);
+        float rhwClip = 1.0f / clip.w;
+        auto raster = screenToRaster(clip * rhwClip);
+        x[i] = clip.x;
+        y[i] = clip.y;
+        z[i] = clip.z;
+        w[i] = clip.w;
+        rhw[i] = rhwClip;
+        rasterX[i] = raster.x;
+        rasterY[i] = raster.y;
+        uint8_t code = 0;
+        code |= clip.x < -clip.w ? kOutsideLeft : 0;
+        code |= clip.x > clip.w ? kOutsideRight : 0;
+        code |= clip.y < -clip.w ? kOutsideBottom : 0;
+        code |= clip.y > clip.w ? kOutsideTop : 0;
+        code |= clip.z < 0.0f ? kOutsideNear : 0;
+        code |= clip.z > clip.w ? kOutsideFar : 0;
+        code |= std::abs(clip.x) > guardBand * clip.w ? kOutsideGuardX : 0;
+        code |= std::abs(clip.y) > guardBand * clip.w ? kOutsideGuardY : 0;
+        outcodes[i] = code;
+    }
+}
+
+//按网格缓存顶点阶段的结果，网格第一次有三角形需要绘制时整体变换，之后的三角形直接按索引读取
+struct VertexCache
+{
+public:
+    //开始新的一帧，之前的变换结果全部失效
+    void Reset(size_t meshCount);
+    //变换faces引用到的、本帧尚未变换的网格，多个网格的顶点分段并行处理
+    void Prepare(const std::vector<std::shared_ptr<Mesh>> &meshes, const std::pair<size_t, size_t> *faces,
+                 size_t count, const Matrix4f &MVP, const Transform &screenToRaster, float guardBand);
+    const ClipVertices &operator[](size_t meshIndex) const { return vertices[meshIndex]; }
+public:
+    //每段并行处理的顶点数量
+    static constexpr size_t kChunkSize = 1024;
+    std::vector<ClipVertices> vertices;
+    std::vector<uint8_t> isTransformed;
+    //本帧变换过的顶点数量
+    size_t transformedCount = 0;
+private:
+    //待变换的(网格索引, 起始顶点)
+    std::vector<std::pair<size_t, size_t>> chunks;
+};
+
+inline void VertexCache::Reset(size_t meshCount)
+{
+    vertices.resize(meshCount);
+    isTransformed.assign(meshCount, 0);
+    transformedCount = 0;
+}
+inline void VertexCache::Prepare(const std::vector<std::shared_ptr<Mesh>> &meshes,
+                                 const std::pair<size_t, size_t> *faces, size_t count,
+                                 const Matrix4f &MVP, const Transform &screenToRaster, float guardBand)
+{
+    chunks.clear();
+    for (size_t i = 0; i < count; ++i)
+    {
+        size_t meshIndex = faces[i].first;
+        if (isTransformed[meshIndex])
+        {
+            continue;
+        }
+        isTransformed[meshIndex] = 1;
+        size_t vertexCount = meshes[meshIndex]->positions.size();
+        vertices[meshIndex].Resize(vertexCount);
+        transformedCount += vertexCount;
+        for (size_t begin = 0; begin < vertexCount; begin += kChunkSize)
+        {
+            chunks.emplace_back(meshIndex, begin);
+        }
+    }
+#ifdef ENABLE_OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+    for (int i = 0; i < static_cast<int>(chunks.size()); ++i)
+    {
+        const auto &[meshIndex, begin] = chunks[i];
+        const auto &positions = meshes[meshIndex]->positions;
+        vertices[meshIndex].TransformRange(positions.data(), begin, std::min(begin + kChunkSize, positions.size()),
+                                           MVP, screenToRaster, guardBand);
+    }
+}
\ No newline at end of file
@@ -63,21 +63,29 @@ struct Bounds3
     //射线相交测试
     bool RayIntersect(const Ray &ray) const
     {
-        Vector3f invDir = 1.0f / ray.direction;
-        Vector3f t0 = (pMin - ray.origin) * invDir;
-        Vector3f t1 = (pMax - ray.origin) * invDir;
-        Vector3f tMin = Min(t0, t1);
-        Vector3f tMax = Max(t0, t1);
-        float tNear = std::max(MaxComponent(tMin), ray.tMin);
-        float tFar = std::min(MinComponent(tMax), ray.tMax);
+        return RayIntersect(ray, 1.0f / ray.direction);
+    }
+    //射线相交测试，使用预计算的方向倒数
+    bool RayIntersect(const Ray &ray, const Vector3f &invDir) const
+    {
+        float tNear = ray.tMin, tFar = ray.tMax;
+        for (int i = 0; i < 3; ++i)
+        {
+            float t0 = (pMin[i] - ray.origin[i]) * invDir[i];
+            float t1 = (pMax[i] - ray.origin[i]) * invDir[i];
+            //方向分量为0且起点位于包围盒表面所在平面时结果为NaN，比较总是为假，该轴不缩小区间
+            if (t0 > t1) std::swap(t0, t1);
+            tNear = t0 > tNear ? t0 : tNear;
+            tFar = t1 < tFar ? t1 : tFar;
+        }
         return tNear <= tFar;
     }
     //包围盒拐角点
     Point3<T> Corner(int i) const {
         return {
                 (*this)[(i & 1)].x,
-                (*this)[(i & 2)].y,
-                (*this)[(i & 4)].z
+                (*this)[(i & 2) ? 1 : 0].y,
+                (*this)[(i & 4) ? 1 : 0].z
         };
     }
     //包围盒中心坐标点
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Math/Matrix.h"
+#include "Just/Math/Vector.h"
+#include "Just/Geometry/Bounds.h"
+
+//视锥，六个平面(a,b,c,d)满足ax+by+cz+d>=0的点在内侧
+struct Frustum
+{
+    //全部平面都需要测试的掩码
+    static constexpr uint32_t kAllPlanes = 0x3F;
+    Vector4f planes[6];
+    Frustum() = default;
+    //从裁剪矩阵提取平面，平面位于矩阵输入空间，裁剪空间可见范围为-w<=x,y<=w, 0<=z<=w
+    explicit Frustum(const Matrix4f &clip);
+    //包围盒与视锥相交测试，只测试planeMask中的平面
+    //包围盒完全在某平面内侧时清除对应位，子节点不必再测试该平面
+    bool Intersect(const Bounds3f &bounds, uint32_t &planeMask) const;
+    bool Intersect(const Bounds3f &bounds) const
+    {
+        uint32_t planeMask = kAllPlanes;
+        return Intersect(bounds, planeMask);
+    }
+    //点到近平面的距离（未归一化），用于由近到远排序
+    float Depth(const Point3f &p) const
+    {
+        return planes[4].x * p.x + planes[4].y * p.y + planes[4].z * p.z + planes[4].w;
+    }
+};
+
+inline Frustum::Frustum(const Matrix4f &clip)
+{
+    auto row = [&clip](int i) { return Vector4f(clip[i][0], clip[i][1], clip[i][2], clip[i][3]); };
+    planes[0] = row(3) + row(0);
+    planes[1] = row(3) - row(0);
+    planes[2] = row(3) + row(1);
+    planes[3] = row(3) - row(1);
+    planes[4] = row(2);
+    planes[5] = row(3) - row(2);
+}
+inline bool Frustum::Intersect(const Bounds3f &bounds, uint32_t &planeMask) const
+{
+    for (int i = 0; i < 6; ++i)
+    {
+        if (!(planeMask & (1u << i)))
+        {
+            continue;
+        }
+        const auto &plane = planes[i];
+        //沿平面法线方向最远的拐角点在外侧时，整个包围盒在视锥外
+        float farthest = plane.x * (plane.x >= 0.0f ? bounds.pMax.x : bounds.pMin.x) +
+                         plane.y * (plane.y >= 0.0f ? bounds.pMax.y : bounds.pMin.y) +
+                         plane.z * (plane.z >= 0.0f ? bounds.pMax.z : bounds.pMin.z) + plane.w;
+        if (farthest < 0.0f)
+        {
+            return false;
+        }
+        //最近的拐角点也在内侧时，包围盒完全在该平面内侧
+        float nearest = plane.x * (plane.x >= 0.0f ? bounds.pMin.x : bounds.pMax.x) +
+                        plane.y * (plane.y >= 0.0f ? bounds.pMin.y : bounds.pMax.y) +
+                        plane.z * (plane.z >= 0.0f ? bounds.pMin.z : bounds.pMax.z) + plane.w;
+        if (nearest >= 0.0f)
+        {
+            planeMask &= ~(1u << i);
+        }
+    }
+    return true;
+}
\ No newline at end of file
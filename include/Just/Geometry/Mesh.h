@@ -27,6 +27,7 @@ struct Mesh {
     float area{};
     Bounds3f bounds;
 public:
+    Mesh() = default;
     Mesh(const std::string &path, const Transform &transform)
     {
         std::ifstream fileStream(path);
@@ -126,6 +127,8 @@ public:
 
     void Active();
 
+    void UpdateBounds();
+
     std::tuple<size_t, size_t, size_t> GetTriangleIndices(size_t faceIndex) const;
 
     Bounds3f GetFaceBounds(size_t faceIndex) const;
@@ -153,6 +156,14 @@ void Mesh::Active() {
     dpdf.Normalize();
 }
 
+//仯¼Χ
+void Mesh::UpdateBounds() {
+    bounds = Bounds3f();
+    for (const auto &p: positions) {
+        bounds.Expand(p);
+    }
+}
+
 //ȡָ
 std::tuple<size_t, size_t, size_t> Mesh::GetTriangleIndices(size_t faceIndex) const{
     return {indices.at( faceIndex * 3 + 0),indices.at( faceIndex * 3 + 1), indices.at( faceIndex * 3 + 2)};
@@ -198,7 +209,7 @@ bool Mesh::RayIntersect(size_t faceIndex, const Ray &ray, HitRecord &record) con
     const float v = Dot(ray.direction, qvec) * invDet;
     if (v < 0.0f || u + v > 1.0f)return false;
     const float t = Dot(edge2, qvec) * invDet;
-    if (t < 0 || t > ray.tMax)return false;
+    if (t < ray.tMin || t > ray.tMax)return false;
     ray.tMax = t;
     record.hitTime = t;
     record.uv = Point2f(u, v);
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Geometry/Ray.h"
+#include "Just/Geometry/Bounds.h"
+
+//8条射线组成的射线包，按分量分别存放，便于同时与包围盒求交
+struct alignas(32) RayPacket8
+{
+    static constexpr int kSize = 8;
+    float originX[kSize], originY[kSize], originZ[kSize];
+    float invDirX[kSize], invDirY[kSize], invDirZ[kSize];
+    float tMin[kSize], tMax[kSize];
+    //未使用的射线tMin大于tMax，包围盒测试总是未击中
+    RayPacket8(const Ray *rays, int count);
+    //8条射线同时与包围盒求交，返回击中射线的位掩码
+    uint32_t IntersectBounds(const Bounds3f &bounds) const;
+};
+
+inline RayPacket8::RayPacket8(const Ray *rays, int count)
+{
+    for (int i = 0; i < kSize; ++i)
+    {
+        if (i < count)
+        {
+            const auto &ray = rays[i];
+            originX[i] = ray.origin.x;
+            originY[i] = ray.origin.y;
+            originZ[i] = ray.origin.z;
+            invDirX[i] = 1.0f / ray.direction.x;
+            invDirY[i] = 1.0f / ray.direction.y;
+            invDirZ[i] = 1.0f / ray.direction.z;
+            tMin[i] = ray.tMin;
+            tMax[i] = ray.tMax;
+        }
+        else
+        {
+            originX[i] = originY[i] = originZ[i] = 0.0f;
+            invDirX[i] = invDirY[i] = invDirZ[i] = 0.0f;
+            tMin[i] = std::numeric_limits<float>::infinity();
+            tMax[i] = -std::numeric_limits<float>::infinity();
+        }
+    }
+}
+
+//与Bounds3::RayIntersect逐条比较的结果一致，min/max的操作数顺序保证NaN不缩小区间
+#if defined(ENABLE_AVX2)
+inline uint32_t RayPacket8::IntersectBounds(const Bounds3f &bounds) const
+{
+    auto slab = [](float pMin, float pMax, const float *origin, const float *invDir, __m256 &tNear, __m256 &tFar) {
+        __m256 o = _mm256_load_ps(origin);
+        __m256 inv = _mm256_load_ps(invDir);
+        __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(pMin), o), inv);
+        __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_set1_ps(pMax), o), inv);
+        tNear = _mm256_max_ps(_mm256_min_ps(t1, t0), tNear);
+        tFar = _mm256_min_ps(_mm256_max_ps(t0, t1), tFar);
+    };
+    __m256 tNear = _mm256_load_ps(tMin);
+    __m256 tFar = _mm256_load_ps(tMax);
+    slab(bounds.pMin.x, bounds.pMax.x, originX, invDirX, tNear, tFar);
+    slab(bounds.pMin.y, bounds.pMax.y, originY, invDirY, tNear, tFar);
+    slab(bounds.pMin.z, bounds.pMax.z, originZ, invDirZ, tNear, tFar);
+    return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+}
+#elif defined(ENABLE_SSE)
+inline uint32_t RayPacket8::IntersectBounds(const Bounds3f &bounds) const
+{
+    //分两次处理4条射线
+    uint32_t mask = 0;
+    for (int half = 0; half < kSize; half += 4)
+    {
+        auto slab = [half](float pMin, float pMax, const float *origin, const float *invDir,
+                           __m128 &tNear, __m128 &tFar) {
+            __m128 o = _mm_load_ps(origin + half);
+            __m128 inv = _mm_load_ps(invDir + half);
+            __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(pMin), o), inv);
+            __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(pMax), o), inv);
+            tNear = _mm_max_ps(_mm_min_ps(t1, t0), tNear);
+            tFar = _mm_min_ps(_mm_max_ps(t0, t1), tFar);
+        };
+        __m128 tNear = _mm_load_ps(tMin + half);
+        __m128 tFar = _mm_load_ps(tMax + half);
+        slab(bounds.pMin.x, bounds.pMax.x, originX, invDirX, tNear, tFar);
+        slab(bounds.pMin.y, bounds.pMax.y, originY, invDirY, tNear, tFar);
+        slab(bounds.pMin.z, bounds.pMax.z, originZ, invDirZ, tNear, tFar);
+        mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar))) << half;
+    }
+    return mask;
+}
+#else
+inline uint32_t RayPacket8::IntersectBounds(const Bounds3f &bounds) const
+{
+    uint32_t mask = 0;
+    for (int i = 0; i < kSize; ++i)
+    {
+        Ray ray;
+        ray.origin = Point3f(originX[i], originY[i], originZ[i]);
+        ray.tMin = tMin[i];
+        ray.tMax = tMax[i];
+        Vector3f invDir(invDirX[i], invDirY[i], invDirZ[i]);
+        mask |= static_cast<uint32_t>(bounds.RayIntersect(ray, invDir)) << i;
+    }
+    return mask;
+}
+#endif
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Math/Vector.h"
+#include "Just/Geometry/Ray.h"
+#include "Just/Core/HitRecord.h"
+
+//预计算三角形，保存顶点0与两条边，求交时无需访问网格
+struct alignas(16) PrecomputedTriangle
+{
+    Point3f p0;
+    Vector3f edge1;
+    Vector3f edge2;
+    uint32_t meshIndex;
+    uint32_t faceIndex;
+    PrecomputedTriangle() : meshIndex(0), faceIndex(0) {}
+    PrecomputedTriangle(const Point3f &p0, const Point3f &p1, const Point3f &p2, uint32_t meshIndex, uint32_t faceIndex)
+            : p0(p0), edge1(p1 - p0), edge2(p2 - p0), meshIndex(meshIndex), faceIndex(faceIndex) {}
+    //最近交点测试，只接受[tMin, tMax]内的交点，与Occluded使用相同的区间
+    bool RayIntersect(const Ray &ray, HitRecord &record) const;
+    //遮挡测试，只判断[tMin, tMax]内是否有交点，不写入任何数据
+    bool Occluded(const Ray &ray) const;
+};
+static_assert(sizeof(PrecomputedTriangle) == 48, "PrecomputedTriangle should be 48 bytes");
+
+//Möller–Trumbore求交，与Mesh::RayIntersect结果一致
+inline bool PrecomputedTriangle::RayIntersect(const Ray &ray, HitRecord &record) const
+{
+    const Vector3f pvec = Cross(ray.direction, edge2);
+    float det = Dot(edge1, pvec);
+    if (det < 1e-8f && det > -1e-8f)return false;
+    float invDet = 1.0f / det;
+    const Vector3f tvec = ray.origin - p0;
+    const float u = Dot(tvec, pvec) * invDet;
+    if (u < 0.0f || u > 1.0f)return false;
+    const Vector3f qvec = Cross(tvec, edge1);
+    const float v = Dot(ray.direction, qvec) * invDet;
+    if (v < 0.0f || u + v > 1.0f)return false;
+    const float t = Dot(edge2, qvec) * invDet;
+    if (t < ray.tMin || t > ray.tMax)return false;
+    ray.tMax = t;
+    record.hitTime = t;
+    record.uv = Point2f(u, v);
+    return true;
+}
+inline bool PrecomputedTriangle::Occluded(const Ray &ray) const
+{
+    const Vector3f pvec = Cross(ray.direction, edge2);
+    float det = Dot(edge1, pvec);
+    if (det < 1e-8f && det > -1e-8f)return false;
+    float invDet = 1.0f / det;
+    const Vector3f tvec = ray.origin - p0;
+    const float u = Dot(tvec, pvec) * invDet;
+    if (u < 0.0f || u > 1.0f)return false;
+    const Vector3f qvec = Cross(tvec, edge1);
+    const float v = Dot(ray.direction, qvec) * invDet;
+    if (v < 0.0f || u + v > 1.0f)return false;
+    const float t = Dot(edge2, qvec) * invDet;
+    return t >= ray.tMin && t <= ray.tMax;
+}
\ No newline at end of file
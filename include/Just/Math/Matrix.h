@@ -26,12 +26,7 @@ struct Matrix
             i++;
         }
     }
-    Matrix(const Matrix<ROW, COL, T> &src)
-    {
-        for (size_t row = 0; row < ROW; row++)
-            for (size_t col = 0; col < COL; col++)
-                matrix[row][col] = src.matrix[row][col];
-    }
+    Matrix(const Matrix<ROW, COL, T> &src) = default;
     ~Matrix() = default;
     const T *operator[](size_t index) const { return matrix[index]; }
     T *operator[](size_t index) { return matrix[index]; }
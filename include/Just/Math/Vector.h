@@ -21,7 +21,7 @@ struct Matrix<1, N, T>
     };
     Matrix() { for (size_t i = 0; i < N; i++)vec[i] = 0; };
     explicit Matrix(T val) { for (size_t i = 0; i < N; i++); }
-    Matrix(const Matrix<1, N, T> &src) { for (size_t i = 0; i < N; i++)matrix[0][i] = src.matrix[0][i]; }
+    Matrix(const Matrix<1, N, T> &src) = default;
     ~Matrix() = default;
     const T &operator[](size_t index) const { return vec[index]; }
     T &operator[](size_t index) { return vec[index]; }
@@ -42,7 +42,7 @@ struct Matrix<1, 2, T>
     Matrix() : x(0), y(0) {}
     explicit Matrix(T val) : x(val), y(val) {}
     Matrix(T x, T y) : x(x), y(y) {}
-    Matrix(const Matrix<1, 2, T> &src) : x(src.x), y(src.y) {}
+    Matrix(const Matrix<1, 2, T> &src) = default;
     explicit Matrix(const Matrix<1, 3, T> &src) : x(src.x), y(src.y) {}
     explicit Matrix(const Matrix<1, 4, T> &src) : x(src.x), y(src.y) {}
     ~Matrix() = default;
@@ -66,7 +66,7 @@ struct Matrix<1, 3, T>
     explicit Matrix(T val) : x(val), y(val), z(val) {}
     Matrix(T x, T y, T z) : x(x), y(y), z(z) {}
     Matrix(const Matrix<1, 2, T> &src, T z) : x(src.x), y(src.y), z(z) {}
-    Matrix(const Matrix<1, 3, T> &src) : x(src.x), y(src.y), z(src.z) {}
+    Matrix(const Matrix<1, 3, T> &src) = default;
     explicit Matrix(const Matrix<1, 4, T> &src) : x(src.x), y(src.y), z(src.z) {}
     ~Matrix() = default;
     const T &operator[](size_t index) const { return vec[index]; }
@@ -94,8 +94,8 @@ struct Matrix<1, 4, T>
     Matrix(T x, T y, T z, T w) : x(x), y(y), z(z), w(w) {}
     Matrix(const Matrix<1, 2, T> &src, T z, T w) : x(src.x), y(src.y), z(z), w(w) {}
     Matrix(const Matrix<1, 3, T> &src, T w) : x(src.x), y(src.y), z(src.z), w(w) {}
-    Matrix(const Matrix<1, 4, T> &src) : x(src.x), y(src.y), z(src.z), w(src.w) {}
-    ~Matrix() {}
+    Matrix(const Matrix<1, 4, T> &src) = default;
+    ~Matrix() = default;
     const T &operator[](size_t index) const { return vec[index]; }
     T &operator[](size_t index) { return vec[index]; }
 };
@@ -181,7 +181,7 @@ Vector3<T> operator*(const Matrix<4, 4, T> &lhs, const Vector3<T> &rhs)
     Vector3<T> ret;
     for (size_t row = 0; row < 3; row++)
         for (size_t i = 0; i < 3; i++)
-            ret[i] += lhs[row][i] * rhs[i];
+            ret[row] += lhs[row][i] * rhs[i];
     return ret;
 }
 //==================================================================================================
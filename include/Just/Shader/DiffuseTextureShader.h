@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Core/Shader.h"
+#include "Just/Core/RasterVertex.h"
+#include "Just/Core/GBuffer.h"
+#include "Just/Core/Texture.h"
+#include "Just/Geometry/Mesh.h"
+#include "Just/Math/Color.h"
+
+//漫反射纹理，TextureType为final的具体纹理类型时Evaluate不经过虚函数表，可以内联
+template<typename TextureType = Texture>
+struct DiffuseTextureShader
+{
+public:
+    DiffuseTextureShader(const ShaderUniforms &uniforms, const TextureType *diffuseMap)
+            : uniforms(uniforms), diffuseMap(diffuseMap) {}
+    void Vertex(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle) const;
+    RGBA32 Fragment(const RasterVertex *triangle, float alpha, float beta, float gamma) const;
+    //延迟渲染时由G-buffer中的表面着色
+    RGBA32 Shade(const GBufferSample &sample) const
+    {
+        return Color3fToRGBA32(diffuseMap->Evaluate(sample.texcoord.x, sample.texcoord.y));
+    }
+public:
+    ShaderUniforms uniforms;
+    //只保存指针，纹理由RenderContext持有
+    const TextureType *diffuseMap;
+};
+
+template<typename TextureType>
+void DiffuseTextureShader<TextureType>::Vertex(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle) const
+{
+    auto i = 3 * faceIndex;
+    for (int j = 0; j < 3; j++)
+    {
+        auto index = mesh.indices[i + j];
+        triangle[j].texcoord = mesh.texcoords.empty() ? Point2f(0, 0) : mesh.texcoords[index];
+    }
+}
+template<typename TextureType>
+RGBA32 DiffuseTextureShader<TextureType>::Fragment(const RasterVertex *triangle,
+                                                   float alpha, float beta, float gamma) const
+{
+    //插值纹理坐标
+    auto texcoord = alpha * triangle[0].texcoord + beta * triangle[1].texcoord + gamma * triangle[2].texcoord;
+    return Color3fToRGBA32(diffuseMap->Evaluate(texcoord.x, texcoord.y));
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Just/Common.h"
+#include "Just/Core/Shader.h"
+#include "Just/Core/RasterVertex.h"
+#include "Just/Core/GBuffer.h"
+#include "Just/Geometry/Mesh.h"
+#include "Just/Math/Color.h"
+
+//法线可视化，网格没有法线时使用面法线
+struct NormalShader
+{
+public:
+    explicit NormalShader(const ShaderUniforms &uniforms) : uniforms(uniforms) {}
+    void Vertex(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle) const;
+    RGBA32 Fragment(const RasterVertex *triangle, float alpha, float beta, float gamma) const;
+    //延迟渲染时由G-buffer中的表面着色
+    RGBA32 Shade(const GBufferSample &sample) const { return ShadeNormal(sample.normal); }
+public:
+    ShaderUniforms uniforms;
+private:
+    static RGBA32 ShadeNormal(const Vector3f &normal);
+};
+
+inline void NormalShader::Vertex(const Mesh &mesh, size_t faceIndex, RasterVertex *triangle) const
+{
+    auto i = 3 * faceIndex;
+    for (int j = 0; j < 3; j++)
+    {
+        triangle[j].pos = mesh.positions[mesh.indices[i + j]];
+    }
+    auto faceNormal = Normalize(Cross((triangle[1].pos - triangle[0].pos), (triangle[2].pos - triangle[0].pos)));
+    for (int j = 0; j < 3; j++)
+    {
+        auto idx = mesh.indices[i + j];
+        triangle[j].normal = mesh.normals.empty() ? faceNormal : mesh.normals[idx];
+    }
+}
+inline RGBA32 NormalShader::Fragment(const RasterVertex *triangle, float alpha, float beta, float gamma) const
+{
+    //插值法线
+    return ShadeNormal(alpha * triangle[0].normal + beta * triangle[1].normal + gamma * triangle[2].normal);
+}
+inline RGBA32 NormalShader::ShadeNormal(const Vector3f &normal)
+{
+    Color3f fragColor = 0.5f * (Color3f{normal.x, normal.y, normal.z} + Color3f(1, 1, 1));
+    return Color3fToRGBA32(LinearToSRGB(fragColor));
+}
\ No newline at end of file
@@ -5,7 +5,7 @@
 #include "Just/Texture/Image.h"
 #include "Just/Core/Texture.h"
 
-struct Texture1D : public Texture
+struct Texture1D final : public Texture
 {
 public:
     std::unique_ptr<Image> image;
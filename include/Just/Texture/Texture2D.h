@@ -5,7 +5,7 @@
 #include "Just/Texture/Image.h"
 #include "Just/Core/Texture.h"
 
-struct Texture2D : public Texture
+struct Texture2D final : public Texture
 {
 public:
     std::unique_ptr<Image> image;
@@ -5,6 +5,7 @@
 #include "Just/Geometry/Mesh.h"
 #include "Just/Core/MeshVertex.h"
 #include "Just/Math/Transform.h"
+#include "Just/Tool/Cache.h"
 
 
 
@@ -21,6 +22,8 @@ public:
 public:
     static Image *LoadImage(const std::string &path);
     static Texture2D *LoadTexture2D(const std::string &path);
+    //读取网格，缓存目录中有相同文件内容与变换的网格时跳过解析
+    static Ref<Mesh> LoadMesh(const std::string &path, const Transform &transform, const std::string &cacheDirectory);
 private:
     AssetsManager() = default;
 };
@@ -55,4 +58,55 @@ Image *AssetsManager::LoadImage(const std::string &path)
 Texture2D *AssetsManager::LoadTexture2D(const std::string &path)
 {
     return new Texture2D(LoadImage(path));
+}
+//检查缓存中的网格：索引不越界且为三角形，法线与纹理坐标为空或与顶点一一对应，包围盒非空
+inline bool IsValidCachedMesh(const Mesh &mesh)
+{
+    const size_t vertexCount = mesh.positions.size();
+    if (mesh.indices.size() % 3 != 0) return false;
+    if (!mesh.normals.empty() && mesh.normals.size() != vertexCount) return false;
+    if (!mesh.texcoords.empty() && mesh.texcoords.size() != vertexCount) return false;
+    for (size_t index: mesh.indices)
+    {
+        if (index >= vertexCount) return false;
+    }
+    if (vertexCount > 0)
+    {
+        const auto &b = mesh.bounds;
+        if (!(b.pMin.x <= b.pMax.x && b.pMin.y <= b.pMax.y && b.pMin.z <= b.pMax.z)) return false;
+    }
+    return true;
+}
+//读取网格
+Ref<Mesh> AssetsManager::LoadMesh(const std::string &path, const Transform &transform,
+                                  const std::string &cacheDirectory)
+{
+    //键为obj文件内容与变换矩阵的哈希
+    uint64_t key;
+    {
+        MappedFile file(path);
+        if (!file.IsValid())
+        {
+            return CreateRef<Mesh>(path, transform);
+        }
+        key = HashValue(transform.matrix, HashBytes(file.data, file.size));
+    }
+    auto cachePath = CachePath(cacheDirectory, key, ".mesh");
+    auto mesh = CreateRef<Mesh>();
+    CacheReader reader(cachePath, key);
+    if (reader.ReadVector(mesh->positions) && reader.ReadVector(mesh->texcoords) &&
+        reader.ReadVector(mesh->normals) && reader.ReadVector(mesh->indices) && reader.Read(mesh->bounds) &&
+        IsValidCachedMesh(*mesh))
+    {
+        return mesh;
+    }
+    //缓存不存在或已损坏时重新解析并覆盖缓存
+    mesh = CreateRef<Mesh>(path, transform);
+    CacheWriter writer(cachePath, key);
+    writer.WriteVector(mesh->positions);
+    writer.WriteVector(mesh->texcoords);
+    writer.WriteVector(mesh->normals);
+    writer.WriteVector(mesh->indices);
+    writer.Write(mesh->bounds);
+    return mesh;
 }
\ No newline at end of file
@@ -0,0 +1,246 @@
+#pragma once
+
+#include "Just/Common.h"
+
+#include <cstring>
+#include <typeinfo>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+//windows.h中与本项目标识符冲突的宏
+#undef near
+#undef far
+#undef LoadImage
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//缓存文件头标识与版本，文件格式变化时增加版本号
+constexpr uint32_t kCacheMagic = 0x4343414A; //"JACC"
+constexpr uint32_t kCacheVersion = 1;
+
+//FNV-1a哈希，每次处理8字节以加快大文件的哈希，seed用于串联多段数据
+inline uint64_t HashBytes(const void *data, size_t size, uint64_t seed = 14695981039346656037ull)
+{
+    auto bytes = static_cast<const unsigned char *>(data);
+    uint64_t hash = seed;
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(uint64_t));
+        hash ^= word;
+        hash *= 1099511628211ull;
+        hash ^= hash >> 32;
+    }
+    for (; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+template<typename T>
+inline uint64_t HashValue(const T &value, uint64_t seed)
+{
+    return HashBytes(&value, sizeof(T), seed);
+}
+template<typename T>
+inline uint64_t HashVector(const std::vector<T> &values, uint64_t seed)
+{
+    seed = HashValue(values.size(), seed);
+    return values.empty() ? seed : HashBytes(values.data(), values.size() * sizeof(T), seed);
+}
+//缓存文件名，哈希值的十六进制表示
+inline std::string CachePath(const std::string &directory, uint64_t key, const std::string &extension)
+{
+    std::ostringstream name;
+    name << std::hex << key << extension;
+    return (std::filesystem::path(directory) / name.str()).string();
+}
+
+//只读内存映射文件，析构时解除映射
+struct MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    bool IsValid() const { return data != nullptr; }
+public:
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+private:
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+#ifdef _WIN32
+inline MappedFile::MappedFile(const std::string &path)
+{
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+    {
+        return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr)
+    {
+        return;
+    }
+    data = static_cast<const unsigned char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size = data != nullptr ? static_cast<size_t>(fileSize.QuadPart) : 0;
+}
+inline MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping != nullptr)
+    {
+        CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(file);
+    }
+}
+#else
+inline MappedFile::MappedFile(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat status{};
+    if (fstat(fd, &status) == 0 && status.st_size > 0)
+    {
+        void *address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED)
+        {
+            data = static_cast<const unsigned char *>(address);
+            size = static_cast<size_t>(status.st_size);
+        }
+    }
+    //映射建立后可以关闭文件描述符
+    close(fd);
+}
+inline MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        munmap(const_cast<unsigned char *>(data), size);
+    }
+}
+#endif
+
+//缓存文件写入，每个数组前写入元素数量
+struct CacheWriter
+{
+public:
+    explicit CacheWriter(const std::string &path, uint64_t key);
+    template<typename T>
+    void Write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "cache data should be trivially copyable");
+        stream.write(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+    template<typename T>
+    void WriteVector(const std::vector<T> &values);
+    bool IsValid() const { return stream.good(); }
+private:
+    std::ofstream stream;
+};
+
+inline CacheWriter::CacheWriter(const std::string &path, uint64_t key)
+{
+    auto directory = std::filesystem::path(path).parent_path();
+    std::error_code error;
+    if (!directory.empty())
+    {
+        std::filesystem::create_directories(directory, error);
+    }
+    stream.open(path, std::ios::binary | std::ios::trunc);
+    Write(kCacheMagic);
+    Write(kCacheVersion);
+    Write(key);
+}
+template<typename T>
+void CacheWriter::WriteVector(const std::vector<T> &values)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "cache data should be trivially copyable");
+    Write(static_cast<uint64_t>(values.size()));
+    stream.write(reinterpret_cast<const char *>(values.data()),
+                 static_cast<std::streamsize>(values.size() * sizeof(T)));
+}
+
+//缓存文件读取，数据直接从映射内存复制，越界或文件头不匹配时读取失败
+struct CacheReader
+{
+public:
+    CacheReader(const std::string &path, uint64_t key);
+    template<typename T>
+    bool Read(T &value);
+    template<typename T>
+    bool ReadVector(std::vector<T> &values);
+    bool IsValid() const { return isValid; }
+private:
+    MappedFile file;
+    size_t offset = 0;
+    bool isValid = false;
+};
+
+inline CacheReader::CacheReader(const std::string &path, uint64_t key) : file(path)
+{
+    if (!file.IsValid())
+    {
+        return;
+    }
+    isValid = true;
+    uint32_t magic = 0, version = 0;
+    uint64_t fileKey = 0;
+    isValid = Read(magic) && Read(version) && Read(fileKey) &&
+              magic == kCacheMagic && version == kCacheVersion && fileKey == key;
+}
+template<typename T>
+bool CacheReader::Read(T &value)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "cache data should be trivially copyable");
+    if (!isValid || file.size - offset < sizeof(T))
+    {
+        return isValid = false;
+    }
+    std::memcpy(static_cast<void *>(&value), file.data + offset, sizeof(T));
+    offset += sizeof(T);
+    return true;
+}
+template<typename T>
+bool CacheReader::ReadVector(std::vector<T> &values)
+{
+    static_assert(std::is_trivially_copyable_v<T>, "cache data should be trivially copyable");
+    uint64_t count = 0;
+    if (!Read(count) || count > (file.size - offset) / sizeof(T))
+    {
+        return isValid = false;
+    }
+    values.resize(static_cast<size_t>(count));
+    std::memcpy(static_cast<void *>(values.data()), file.data + offset, static_cast<size_t>(count) * sizeof(T));
+    offset += static_cast<size_t>(count) * sizeof(T);
+    return true;
+}
\ No newline at end of file
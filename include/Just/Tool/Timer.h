@@ -11,11 +11,11 @@ struct Timer {
 
     void Begin() {
         time = 0;
-        start = std::chrono::high_resolution_clock::now();
+        start = std::chrono::steady_clock::now();
     }
 
     void End() {
-        end = std::chrono::high_resolution_clock::now();
+        end = std::chrono::steady_clock::now();
         std::chrono::duration<float> duration = end - start;
         time = duration.count() * 1000.0f;
     }
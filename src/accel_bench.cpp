@@ -0,0 +1,385 @@
+#include "Just/Tool/AssetsManager.h"
+#include "Just/Camera/ProjectiveCamera.h"
+#include "Just/Core/Scene.h"
+#include "Just/Tool/Random.h"
+#include "Just/Tool/Timer.h"
+
+//生成射向场景包围盒内随机点的射线
+std::vector<Ray> GenerateRays(const Bounds3f &bounds, int count)
+{
+    RNG rng;
+    std::vector<Ray> rays;
+    rays.reserve(count);
+    Point3f center = bounds.Centroid();
+    float radius = Length(bounds.Diagonal());
+    for (int i = 0; i < count; ++i)
+    {
+        Vector3f dir = Warp::SquareToUniformSphere(Point2f{rng.UniformFloat(), rng.UniformFloat()});
+        Point3f origin = center + dir * radius;
+        Point3f target{rng.UniformFloat(bounds.pMin.x, bounds.pMax.x),
+                       rng.UniformFloat(bounds.pMin.y, bounds.pMax.y),
+                       rng.UniformFloat(bounds.pMin.z, bounds.pMax.z)};
+        rays.emplace_back(origin, target - origin);
+    }
+    return rays;
+}
+
+//三角形求交吞吐量：网格索引求交与预计算三角形求交
+void BenchTriangleTests(const std::shared_ptr<BVHAccel> &accel, const std::vector<Ray> &rays)
+{
+    Timer timer;
+    size_t tests = rays.size() * accel->faceIndices.size();
+    size_t hits = 0;
+    timer.Begin();
+    for (const auto &ray: rays)
+    {
+        HitRecord record;
+        for (auto [meshIndex, faceIndex]: accel->faceIndices)
+        {
+            hits += accel->meshes[meshIndex]->RayIntersect(faceIndex, ray, record);
+        }
+        ray.tMax = std::numeric_limits<float>::max();
+    }
+    timer.End();
+    std::cout << "[mesh triangle tests]: " << static_cast<float>(tests) / timer.time / 1000.0f << " M/s"
+              << " (hits " << hits << ")" << std::endl;
+    hits = 0;
+    timer.Begin();
+    for (const auto &ray: rays)
+    {
+        HitRecord record;
+        for (const auto &triangle: accel->triangles)
+        {
+            hits += triangle.RayIntersect(ray, record);
+        }
+        ray.tMax = std::numeric_limits<float>::max();
+    }
+    timer.End();
+    std::cout << "[precomputed triangle tests]: " << static_cast<float>(tests) / timer.time / 1000.0f << " M/s"
+              << " (hits " << hits << ")" << std::endl;
+}
+
+//场景求交吞吐量
+void BenchRays(const std::shared_ptr<Scene> &scene, const std::vector<Ray> &rays, const std::string &name)
+{
+#ifdef ENABLE_ACCEL_STATS
+    //只统计本次测试的射线
+    TraversalCounterRegistry::GetInstance().Merge();
+    scene->stats = AccelStats();
+#endif
+    Timer timer;
+    size_t hits = 0;
+    timer.Begin();
+    for (const auto &ray: rays)
+    {
+        Ray r = ray;
+        HitRecord record;
+        hits += scene->RayIntersect(r, record);
+    }
+    timer.End();
+    std::cout << "[" << name << " closest]: " << static_cast<float>(rays.size()) / timer.time / 1000.0f << " Mrays/s"
+              << " (hits " << hits << ")" << std::endl;
+#ifdef ENABLE_ACCEL_STATS
+    scene->MergeStats();
+    std::cout << "[" << name << " stats]: " << scene->stats.ToJson() << std::endl;
+#endif
+}
+
+//按4x2的像素块生成看向场景中心的相机射线
+std::vector<Ray> GenerateCameraRays(const Bounds3f &bounds, const Point2i &res)
+{
+    Point3f target = bounds.Centroid();
+    Point3f origin = target - Vector3f(0.0f, 0.0f, 1.2f * Length(bounds.Diagonal()));
+    PerspectiveCamera camera(res, LookAt(origin, target, Vector3f(0, 1, 0)), 45, 1e-2f, 1e4f);
+    std::vector<Ray> rays;
+    rays.reserve(res.x * res.y);
+    for (int tileY = 0; tileY < res.y; tileY += 2)
+        for (int tileX = 0; tileX < res.x; tileX += 4)
+            for (int y = tileY; y < tileY + 2; ++y)
+                for (int x = tileX; x < tileX + 4; ++x)
+                    rays.push_back(camera.GenerateRay(Point2f(float(x), float(y))));
+    return rays;
+}
+
+//相机射线吞吐量：逐条求交与4x2像素块组成的射线包求交
+void BenchCameraRays(const std::shared_ptr<Scene> &scene, const Bounds3f &bounds)
+{
+    auto rays = GenerateCameraRays(bounds, Point2i(768, 768));
+    Timer timer;
+    size_t hits = 0;
+    timer.Begin();
+    for (const auto &ray: rays)
+    {
+        Ray r = ray;
+        HitRecord record;
+        hits += scene->RayIntersect(r, record);
+    }
+    timer.End();
+    std::cout << "[camera scalar]: " << static_cast<float>(rays.size()) / timer.time / 1000.0f << " Mrays/s"
+              << " (hits " << hits << ")" << std::endl;
+    hits = 0;
+    timer.Begin();
+    for (size_t i = 0; i < rays.size(); i += RayPacket8::kSize)
+    {
+        Ray packet[RayPacket8::kSize];
+        HitRecord records[RayPacket8::kSize];
+        std::copy(rays.begin() + i, rays.begin() + i + RayPacket8::kSize, packet);
+        uint32_t mask = scene->RayIntersectPacket8(packet, records);
+        for (int j = 0; j < RayPacket8::kSize; ++j)
+        {
+            hits += (mask >> j) & 1;
+        }
+    }
+    timer.End();
+    std::cout << "[camera packet8]: " << static_cast<float>(rays.size()) / timer.time / 1000.0f << " Mrays/s"
+              << " (hits " << hits << ")" << std::endl;
+}
+
+//阴影射线吞吐量：从相机射线交点射向场景上方的点光源
+void BenchShadowRays(const std::shared_ptr<Scene> &scene, const Bounds3f &bounds)
+{
+    Point3f lightPos = bounds.Centroid() + Vector3f(0.0f, 0.45f * bounds.Diagonal().y, 0.0f);
+    std::vector<Ray> shadowRays;
+    std::vector<float> distances;
+    for (const auto &ray: GenerateCameraRays(bounds, Point2i(512, 512)))
+    {
+        Ray r = ray;
+        HitRecord record;
+        if (scene->RayIntersect(r, record))
+        {
+            //起点沿射线方向偏移，避免与自身相交
+            Vector3f toLight = lightPos - record.hitPoint;
+            float offset = 1e-4f * Length(bounds.Diagonal());
+            shadowRays.emplace_back(record.hitPoint + Normalize(toLight) * offset, toLight);
+            distances.push_back(Length(toLight) - offset);
+        }
+    }
+    Timer timer;
+    size_t occluded = 0;
+    timer.Begin();
+    for (size_t i = 0; i < shadowRays.size(); ++i)
+    {
+        Ray r = shadowRays[i];
+        r.tMax = distances[i];
+        HitRecord record;
+        occluded += scene->accel->RayIntersect(r, record, true);
+    }
+    timer.End();
+    std::cout << "[shadow with record]: " << static_cast<float>(shadowRays.size()) / timer.time / 1000.0f
+              << " Mrays/s (occluded " << occluded << "/" << shadowRays.size() << ")" << std::endl;
+    occluded = 0;
+    timer.Begin();
+    for (size_t i = 0; i < shadowRays.size(); ++i)
+    {
+        occluded += scene->Occluded(shadowRays[i], distances[i]);
+    }
+    timer.End();
+    std::cout << "[shadow occluded]: " << static_cast<float>(shadowRays.size()) / timer.time / 1000.0f
+              << " Mrays/s (occluded " << occluded << "/" << shadowRays.size() << ")" << std::endl;
+}
+
+//漫反射次级射线吞吐量：从相机射线交点按余弦分布采样反弹方向，逐条求交与排序后的射线流求交对比
+void BenchDiffuseBounces(const std::shared_ptr<Scene> &scene, const Bounds3f &bounds, int spp)
+{
+    RNG rng;
+    std::vector<Ray> bounceRays;
+    float offset = 1e-4f * Length(bounds.Diagonal());
+    for (const auto &ray: GenerateCameraRays(bounds, Point2i(256, 256)))
+    {
+        Ray r = ray;
+        HitRecord record;
+        if (!scene->RayIntersect(r, record))
+        {
+            continue;
+        }
+        //法线朝向入射方向一侧
+        Frame frame = Dot(record.geoFrame.n, ray.direction) < 0.0f ? record.geoFrame : Frame(-record.geoFrame.n);
+        for (int i = 0; i < spp; ++i)
+        {
+            Vector3f dir = frame.ToWorld(Warp::SquareToCosineHemisphere(Point2f{rng.UniformFloat(), rng.UniformFloat()}));
+            bounceRays.emplace_back(record.hitPoint + frame.n * offset, dir);
+        }
+    }
+    //多次反弹后同一批次中的射线来自不同路径，打乱顺序模拟不相干的射线
+    std::shuffle(bounceRays.begin(), bounceRays.end(), std::mt19937(7));
+    std::vector<HitRecord> records(bounceRays.size());
+    Timer timer;
+    size_t hits = 0;
+    timer.Begin();
+    for (size_t i = 0; i < bounceRays.size(); ++i)
+    {
+        Ray r = bounceRays[i];
+        hits += scene->RayIntersect(r, records[i]);
+    }
+    timer.End();
+    std::cout << "[diffuse scalar]: " << static_cast<float>(bounceRays.size()) / timer.time / 1000.0f
+              << " Mrays/s (hits " << hits << "/" << bounceRays.size() << ")" << std::endl;
+    timer.Begin();
+    hits = scene->RayIntersectStream(bounceRays.data(), records.data(), bounceRays.size());
+    timer.End();
+    std::cout << "[diffuse stream]: " << static_cast<float>(bounceRays.size()) / timer.time / 1000.0f
+              << " Mrays/s (hits " << hits << "/" << bounceRays.size() << ")" << std::endl;
+}
+
+//加速结构占用内存
+size_t AccelMemory(const std::shared_ptr<BVHAccel> &accel)
+{
+    return accel->linearTree.size() * sizeof(LinearBVHNode) +
+           accel->triangles.size() * sizeof(PrecomputedTriangle) +
+           accel->faceIndices.size() * sizeof(std::pair<size_t, size_t>);
+}
+
+//空间划分BVH与普通BVH对比：构建时间、引用数量、每条射线访问节点数与吞吐量
+void BenchSpatialSplits(const std::shared_ptr<Scene> &scene, const std::vector<Ray> &rays)
+{
+    std::vector<std::pair<std::string, std::shared_ptr<BVHAccel>>> accels = {
+            {"bvh", std::make_shared<BVHAccel>()},
+            {"sbvh", std::make_shared<SBVHAccel>()}
+    };
+    for (const auto &[name, accel]: accels)
+    {
+        auto splitScene = std::make_shared<Scene>(accel);
+        for (const auto &mesh: scene->meshes)
+        {
+            splitScene->AddMesh(mesh);
+        }
+        Timer timer;
+        timer.Begin();
+        splitScene->BuildAccel();
+        timer.End();
+        std::cout << "[" << name << " build]: " << timer.time << " ms" << std::endl;
+        std::cout << "[" << name << " nodes]: " << accel->linearTree.size()
+                  << " (references " << accel->faceIndices.size() << ")" << std::endl;
+        size_t steps = 0;
+        for (const auto &ray: rays)
+        {
+            steps += accel->TraversalSteps(ray);
+        }
+        std::cout << "[" << name << " steps per ray]: " << static_cast<float>(steps) / static_cast<float>(rays.size())
+                  << std::endl;
+        BenchRays(splitScene, rays, name);
+    }
+}
+
+//实例化：同一网格的大量实例共享底层BVH
+void BenchInstances(const std::string &file, int gridSize)
+{
+    auto accel = std::make_shared<InstanceAccel>();
+    auto scene = std::make_shared<Scene>(accel);
+    scene->AddMesh(CreateRef<Mesh>(file, Transform()));
+    scene->BuildAccel();
+    //网格状摆放并随机旋转
+    RNG rng;
+    Vector3f extent = accel->blases[0]->bounds.Diagonal();
+    float spacing = 1.5f * MaxComponent(extent);
+    accel->instances.clear();
+    for (int x = 0; x < gridSize; ++x)
+    {
+        for (int z = 0; z < gridSize; ++z)
+        {
+            auto transform = Translate({static_cast<float>(x) * spacing, 0.0f, static_cast<float>(z) * spacing}) *
+                             RotateY(rng.UniformFloat(0.0f, 360.0f));
+            accel->AddInstance(0, transform);
+        }
+    }
+    Timer timer;
+    timer.Begin();
+    accel->BuildTopLevel();
+    timer.End();
+    std::cout << "[top level build]: " << timer.time << " ms" << std::endl;
+    //内存：实例化与展开成独立网格的对比
+    size_t blasMemory = AccelMemory(accel->blases[0]);
+    size_t instanceMemory = blasMemory + AccelMemory(accel) +
+                            accel->instances.size() * sizeof(Instance) +
+                            accel->instanceOrder.size() * sizeof(uint32_t);
+    std::cout << "[instance count]: " << accel->instances.size() << std::endl;
+    std::cout << "[instanced memory]: " << static_cast<float>(instanceMemory) / 1024.0f << " KB" << std::endl;
+    std::cout << "[flattened memory estimate]: "
+              << static_cast<float>(blasMemory * accel->instances.size()) / 1024.0f / 1024.0f << " MB" << std::endl;
+    auto rays = GenerateRays(accel->bounds, 1 << 16);
+    BenchRays(scene, rays, "instanced");
+}
+
+//压缩BVH与线性BVH对比：每个三角形占用的内存与吞吐量
+void BenchCompressed(const std::shared_ptr<Scene> &scene, const std::vector<Ray> &rays)
+{
+    size_t triangleCount = 0;
+    for (const auto &mesh: scene->meshes)
+    {
+        triangleCount += mesh->GetTriangleCount();
+    }
+    for (bool isPrecomputed: {true, false})
+    {
+        auto linear = std::make_shared<BVHAccel>();
+        auto compressed = std::make_shared<CompressedBVHAccel>();
+        linear->isPrecomputed = isPrecomputed;
+        compressed->isPrecomputed = isPrecomputed;
+        std::string suffix = isPrecomputed ? " precomputed" : " mesh indexed";
+        std::vector<std::shared_ptr<BVHAccel>> accels = {linear, compressed};
+        for (const auto &accel: accels)
+        {
+            auto benchScene = std::make_shared<Scene>(accel);
+            for (const auto &mesh: scene->meshes)
+            {
+                benchScene->AddMesh(mesh);
+            }
+            benchScene->BuildAccel();
+            std::string name = (accel == linear ? "linear" : "compressed") + suffix;
+            size_t memory = accel == linear ? AccelMemory(linear) : compressed->MemoryUsage();
+            std::cout << "[" << name << " bytes per triangle]: "
+                      << static_cast<float>(memory) / static_cast<float>(triangleCount) << std::endl;
+            BenchRays(benchScene, rays, name);
+        }
+    }
+}
+
+int main()
+{
+    //资源
+    //==================================================================================================
+    std::string workspace = "D:\\HybridRenderer\\";
+    std::vector<std::vector<std::string>> scenes = {
+            {"res\\bunny.obj"},
+            {"res\\meshes\\backwall.obj", "res\\meshes\\celling.obj", "res\\meshes\\floor.obj",
+             "res\\meshes\\leftwall.obj", "res\\meshes\\rightwall.obj", "res\\meshes\\light.obj",
+             "res\\meshes\\sphere1.obj", "res\\meshes\\sphere2.obj"}
+    };
+    for (const auto &files: scenes)
+    {
+        //构建场景
+        //==============================================================================================
+        auto accel = std::make_shared<BVHAccel>();
+        auto scene = std::make_shared<Scene>(accel);
+        for (const auto &file: files)
+        {
+            scene->AddMesh(CreateRef<Mesh>(workspace + file, Transform()));
+        }
+        scene->BuildAccel();
+        auto rays = GenerateRays(accel->bounds, 1 << 16);
+        //测试
+        //==============================================================================================
+        BenchTriangleTests(accel, std::vector<Ray>(rays.begin(), rays.begin() + 256));
+        BenchRays(scene, rays, "precomputed");
+        BenchCameraRays(scene, accel->bounds);
+        BenchShadowRays(scene, accel->bounds);
+        BenchDiffuseBounces(scene, accel->bounds, 16);
+        accel->isPrecomputed = false;
+        scene->BuildAccel();
+        BenchRays(scene, rays, "mesh indexed");
+        //8叉BVH
+        auto wideScene = std::make_shared<Scene>(AccelType::WideBVHAccel);
+        for (const auto &mesh: scene->meshes)
+        {
+            wideScene->AddMesh(mesh);
+        }
+        wideScene->BuildAccel();
+        BenchRays(wideScene, rays, "wide bvh8");
+        BenchShadowRays(wideScene, accel->bounds);
+        //空间划分BVH
+        BenchSpatialSplits(scene, rays);
+        //压缩BVH
+        BenchCompressed(scene, rays);
+    }
+    BenchInstances(workspace + "res\\bunny.obj", 100);
+    return 0;
+}
\ No newline at end of file
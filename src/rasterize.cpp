@@ -16,8 +16,8 @@ int main()
     Vector3f up(0, 1, 0);
     Point2i res(768, 768);
     float fov = 45;
-    float zNear = 1e-4f;
-    float zFar = 1e4f;
+    float zNear = 0.1f;
+    float zFar = 1000.0f;
     //资源
     //==================================================================================================
     std::string workspace = "D:\\HybridRenderer\\";
@@ -61,6 +61,11 @@ int main()
     timer.End();
     std::cout << "[render time]: " << timer.time << "ms" << std::endl;
     std::cout << "[FPS]: " << 1000.0f / timer.time << std::endl;
+#ifdef ENABLE_ACCEL_STATS
+    //Hi-Z剔除比例
+    std::cout << "[occlusion stats]: " << context->frameBuffer->hiZ.stats.ToJson() << std::endl;
+    std::ofstream(workspace + "output\\occlusion_stats.json") << context->frameBuffer->hiZ.stats.ToJson();
+#endif
     //==================================================================================================
     //保存
     SaveImageToPNG(workspace + "output\\sphere_normal_rasterize_5.png", res.x, res.y, 4,
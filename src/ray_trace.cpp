@@ -24,18 +24,20 @@ int main()
     //资源
     //==================================================================================================
     std::string workspace = "D:\\HybridRenderer\\";
+    //网格与加速结构缓存目录
+    std::string cacheDirectory = workspace + "cache\\";
     auto texture_diffuse = std::shared_ptr<Texture2D>(AssetsManager::LoadTexture2D(workspace+"res\\test_cube_diffuse.tga"));
     auto texture_constant = std::make_shared<ConstantTexture>(Color3f{1.0f, 0.0f, 0.0f});
 
 
     Timer timer;
     timer.Begin();
-    auto mesh1 = CreateRef<Mesh>(workspace + "res\\sphere.obj", modelTransform);
-    auto mesh2 = CreateRef<Mesh>(workspace+ "res\\plane.obj",modelTransform);
+    auto mesh1 = AssetsManager::LoadMesh(workspace + "res\\sphere.obj", modelTransform, cacheDirectory);
+    auto mesh2 = AssetsManager::LoadMesh(workspace + "res\\plane.obj", modelTransform, cacheDirectory);
     mesh1->Active();
     mesh2->Active();
     auto lightTransform =  Translate(Vector3f(0, 50, 100));
-    auto lightMesh = CreateRef<Mesh>(workspace+"res\\plane.obj",lightTransform);
+    auto lightMesh = AssetsManager::LoadMesh(workspace + "res\\plane.obj", lightTransform, cacheDirectory);
     auto emitter = CreateRef<AreaLight>(Color3f(1000));
     lightMesh->emitter = emitter;
     lightMesh->Active();
@@ -63,7 +65,7 @@ int main()
     scene->AddMesh(mesh1);
     scene->AddMesh(mesh2);
     scene->AddMesh(lightMesh);
-    scene->BuildAccel();
+    scene->BuildAccel(cacheDirectory);
     timer.End();
     std::cout << "[build time]: " << timer.time << "ms" << std::endl;
     //渲染场景
@@ -74,6 +76,10 @@ int main()
     timer.End();
     std::cout << "[render time]: " << timer.time << "ms" << std::endl;
     std::cout << "[FPS]: " << 1000.0f / timer.time << std::endl;
+#ifdef ENABLE_ACCEL_STATS
+    scene->MergeStats();
+    scene->SaveStats(workspace + "output\\accel_stats.json");
+#endif
     //==================================================================================================
     //保存
     SaveImageToPNG(workspace + "output\\sphere_normal_ray_tracing_4.png", res.x, res.y, 4,